@@ -17,10 +17,20 @@
  */
 Block* makeBlock() {
     Block *block = (Block*) malloc(sizeof(Block));
-    block->len = 0;
+    initBlock(block);
     return block;
 }
 
+/**
+ * This function initializes a block the caller already has storage for, usually a
+ * local variable, to indicate the block is empty. The hashing code uses this so it
+ * never touches the heap.
+ * @param block pointer to the block to initialize
+ */
+void initBlock(Block *block) {
+    block->len = 0;
+}
+
 /**
  *This function frees the memory for the given block.
  * @param block pointer to a block
@@ -40,7 +50,6 @@ void freeBlock(Block *block) {
 void appendByte(Block *dest, byte b) {
     if (dest->len >= BLOCK_SIZE) {
         fprintf(stderr, "Block overflow\n");
-        freeBlock(dest);
         exit(1);
     }
     dest->data[dest->len++] = b;
@@ -53,12 +62,21 @@ void appendByte(Block *dest, byte b) {
  * @param src
  */
 void appendString(Block *dest, char const *src) {
-    if ((strlen(src) + dest->len) > BLOCK_SIZE) {
+    appendBytes(dest, src, strlen(src));
+}
+
+/**
+ * This function stores the given number of bytes at the end of the given block, so
+ * callers that already know a string's length don't have to measure it again.
+ * @param dest the block to append to
+ * @param src the bytes to append
+ * @param len number of bytes
+ */
+void appendBytes(Block *dest, char const *src, int len) {
+    if (len + dest->len > BLOCK_SIZE) {
         fprintf(stderr, "Block overflow\n");
-        freeBlock(dest);
         exit(1);
     }
-    for (int i = 0; i < strlen(src); i++) {
-        dest->data[dest->len++] = src[i];
-    }
+    memcpy(dest->data + dest->len, src, len);
+    dest->len += len;
 }
@@ -24,13 +24,20 @@ typedef struct {
  */
 void freeBlock(Block *block);
 
-/** creates a block */
+/** creates a block on the heap, for callers that need one to outlive them */
 Block* makeBlock();
 
+/** marks a block the caller owns (usually on its stack) as empty, so hashing
+ * never has to allocate */
+void initBlock(Block *block);
+
 /** appends a byte to the block */
 void appendByte(Block *dest, byte b);
 
 /** appends a string to the block */
 void appendString(Block *dest, char const *src);
 
+/** appends len bytes to the block, for callers that already know the length */
+void appendBytes(Block *dest, char const *src, int len);
+
 #endif
@@ -0,0 +1,191 @@
+/**
+ * @file checkpoint.c
+ * @author Sean Leana (smleana)
+ * This file saves and loads checkpoints. Saving is cheap: the cursor comes from the
+ * engine's count of finished batches, and the only other state is the list of
+ * cracked passwords, which is short next to the work it stands for.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "checkpoint.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/** First line of every checkpoint. */
+#define CHECKPOINT_HEADER "crack checkpoint 1"
+
+/** Longest line a checkpoint can have, with its newline and a null. */
+#define CHECKPOINT_LINE 4096
+
+/**
+ * Returns the current time in seconds, on a clock that doesn't jump.
+ * @return the time
+ */
+static time_t now()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec;
+}
+
+/**
+ * Reads one line, without its newline.
+ * @param fp the file
+ * @param line where the line is stored
+ * @return false at the end of the file, or if the line is too long
+ */
+static bool readLine(FILE *fp, char line[CHECKPOINT_LINE])
+{
+    if (fgets(line, CHECKPOINT_LINE, fp) == NULL) {
+        return false;
+    }
+    size_t len = strlen(line);
+    if (len == 0 || line[len - 1] != '\n') {
+        return false;
+    }
+    line[len - 1] = '\0';
+    return true;
+}
+
+/**
+ * Sets up checkpoints for a job.
+ * @param cp the checkpoint state to initialize
+ * @param filename name of the checkpoint file
+ * @param job description of the job
+ * @param targets the users being cracked
+ * @param interval number of seconds between checkpoints, or 0
+ */
+void initCheckpoint(Checkpoint *cp, char const *filename, char const *job,
+                    TargetSet const *targets, int interval)
+{
+    cp->filename = filename;
+    cp->job = job;
+    cp->targets = targets;
+    cp->interval = interval;
+    cp->last = now();
+    cp->saved = 0;
+}
+
+/**
+ * Writes a checkpoint to a temporary file, then renames it over the checkpoint file.
+ * @param cp the checkpoint state
+ * @param engine the engine, for its cracked passwords
+ * @param cursor where the candidate generator should pick up
+ * @return false if the checkpoint couldn't be written, with errno set
+ */
+bool saveCheckpoint(Checkpoint *cp, Engine *engine, long long cursor)
+{
+    size_t len = strlen(cp->filename);
+    char *temp = (char *) malloc(len + 5);
+    memcpy(temp, cp->filename, len);
+    strcpy(temp + len, ".tmp");
+
+    FILE *fp = fopen(temp, "w");
+    if (fp == NULL) {
+        free(temp);
+        return false;
+    }
+    fprintf(fp, "%s\njob %s\ncursor %lld\n", CHECKPOINT_HEADER, cp->job, cursor);
+
+    // A password cracked by a later batch can be ready before one from an earlier
+    // batch, so look at every place one could be.
+    TargetSet const *targets = cp->targets;
+    char password[PW_LIMIT + 1];
+    for (int k = 0; k < targets->digestCount; k++) {
+        int d = crackedPassword(engine, k, password);
+        if (d >= 0) {
+            writePotEntry(fp, targets->groups[targets->digests[d].group].salt,
+                          targets->digests[d].hash, password);
+        }
+    }
+
+    bool ok = fflush(fp) == 0 && fsync(fileno(fp)) == 0;
+    ok = fclose(fp) == 0 && ok;
+    ok = ok && rename(temp, cp->filename) == 0;
+    free(temp);
+    cp->last = now();
+    cp->saved++;
+    return ok;
+}
+
+/**
+ * Saves a checkpoint once all the work handed out so far is done, so the cursor can
+ * be exactly where the reader stopped.
+ * @param cp the checkpoint state
+ * @param engine the engine
+ * @param cursor the reader's cursor
+ * @return false if the checkpoint couldn't be written, with errno set
+ */
+bool finalCheckpoint(Checkpoint *cp, Engine *engine, long long cursor)
+{
+    int spins = 0;
+    while (!engineIdle(engine)) {
+        idleWait(&spins);
+    }
+    return saveCheckpoint(cp, engine, cursor);
+}
+
+/**
+ * Saves a checkpoint if it's time for one.
+ * @param cp the checkpoint state
+ * @param engine the engine
+ * @param start where the candidate generator started, in case no batch is finished
+ */
+void tickCheckpoint(Checkpoint *cp, Engine *engine, long long start)
+{
+    if (cp->interval > 0 && now() - cp->last >= cp->interval) {
+        long long cursor = engineCursor(engine);
+        saveCheckpoint(cp, engine, cursor >= 0 ? cursor : start);
+    }
+}
+
+/**
+ * Reads a checkpoint.
+ * @param filename name of the checkpoint file
+ * @param job description of the job it has to be for
+ * @param cursor where the checkpoint's cursor is stored
+ * @param cracked table the checkpoint's passwords are added to
+ * @return CHECKPOINT_LOADED, CHECKPOINT_UNREADABLE, CHECKPOINT_INVALID or
+ * CHECKPOINT_MISMATCH
+ */
+int loadCheckpoint(char const *filename, char const *job, long long *cursor,
+                   Potfile *cracked)
+{
+    FILE *fp = fopen(filename, "r");
+    if (fp == NULL) {
+        return CHECKPOINT_UNREADABLE;
+    }
+
+    char line[CHECKPOINT_LINE];
+    int status = CHECKPOINT_LOADED;
+    char extra;
+    if (!readLine(fp, line) || strcmp(line, CHECKPOINT_HEADER) != 0
+            || !readLine(fp, line) || strncmp(line, "job ", 4) != 0) {
+        status = CHECKPOINT_INVALID;
+    } else if (strcmp(line + 4, job) != 0) {
+        status = CHECKPOINT_MISMATCH;
+    } else if (!readLine(fp, line) || sscanf(line, "cursor %lld%c", cursor, &extra) != 1
+               || *cursor < 0) {
+        status = CHECKPOINT_INVALID;
+    }
+
+    // Every line has a newline, so anything left over at the end is a bad line.
+    while (status == CHECKPOINT_LOADED) {
+        line[0] = '\0';
+        if (readLine(fp, line)) {
+            if (!loadPotEntry(cracked, line)) {
+                status = CHECKPOINT_INVALID;
+            }
+        } else {
+            if (line[0] != '\0' || !feof(fp)) {
+                status = CHECKPOINT_INVALID;
+            }
+            break;
+        }
+    }
+    fclose(fp);
+    return status;
+}
@@ -0,0 +1,87 @@
+/**
+ * @file checkpoint.h
+ * @author Sean Leana (smleana)
+ * This file defines checkpoints, which let a long job pick up where it left off after
+ * it's stopped. A checkpoint is a small text file: a description of the job, the
+ * position of the candidate generator that every salt has been hashed up to, and the
+ * passwords cracked so far, one per line in the potfile's format:
+ *
+ *   crack checkpoint 1
+ *   job dictionary words.txt shadow.txt
+ *   cursor 123456
+ *   $1$salt1234$MPPZJeod4Sk89awLhwv591:password
+ *
+ * It's written to a temporary file that's then renamed over the old one, so there's
+ * always a whole checkpoint on disk, even if the job is killed while writing one.
+ */
+
+#ifndef _CHECKPOINT_H_
+#define _CHECKPOINT_H_
+
+#include "engine.h"
+#include "target.h"
+#include "potfile.h"
+#include <stdbool.h>
+#include <time.h>
+
+/** Default number of seconds between checkpoints. */
+#define CHECKPOINT_SECONDS 60
+
+/** Result of loadCheckpoint() when the checkpoint was loaded. */
+#define CHECKPOINT_LOADED 1
+
+/** Result of loadCheckpoint() when the file can't be read; errno is set. */
+#define CHECKPOINT_UNREADABLE 0
+
+/** Result of loadCheckpoint() when the file isn't a valid checkpoint. */
+#define CHECKPOINT_INVALID -1
+
+/** Result of loadCheckpoint() when the checkpoint is for a different job. */
+#define CHECKPOINT_MISMATCH -2
+
+/** Where and how often a job saves its checkpoints. */
+typedef struct {
+    /** Name of the checkpoint file. */
+    char const *filename;
+
+    /** Description of the job, so a checkpoint only restores into the same one. */
+    char const *job;
+
+    /** The users being cracked. */
+    TargetSet const *targets;
+
+    /** Number of seconds between checkpoints, or 0 to save only when asked, and when
+        the last one was saved. */
+    int interval;
+    time_t last;
+
+    /** Number of checkpoints saved. */
+    int saved;
+} Checkpoint;
+
+/** sets up checkpoints for the given job, saved to the given file every interval
+ * seconds */
+void initCheckpoint( Checkpoint *cp, char const *filename, char const *job,
+                     TargetSet const *targets, int interval );
+
+/** saves a checkpoint at the given cursor, with every password the engine has cracked.
+ * Returns false, with errno set, if it can't be written. */
+bool saveCheckpoint( Checkpoint *cp, Engine *engine, long long cursor );
+
+/** waits until the workers have finished every batch published so far, then saves a
+ * checkpoint at the given cursor. Returns false, with errno set, if it can't be
+ * written. */
+bool finalCheckpoint( Checkpoint *cp, Engine *engine, long long cursor );
+
+/** saves a checkpoint if the interval has passed since the last one, at the engine's
+ * cursor, or at start if the engine hasn't finished a batch yet. Only the reader may
+ * call this. */
+void tickCheckpoint( Checkpoint *cp, Engine *engine, long long start );
+
+/** reads the checkpoint in the given file, if it's for the given job, storing its
+ * cursor and adding its passwords to cracked. Returns CHECKPOINT_LOADED,
+ * CHECKPOINT_UNREADABLE, CHECKPOINT_INVALID or CHECKPOINT_MISMATCH. */
+int loadCheckpoint( char const *filename, char const *job, long long *cursor,
+                    Potfile *cracked );
+
+#endif
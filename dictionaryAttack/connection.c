@@ -0,0 +1,254 @@
+/**
+ * @file connection.c
+ * @author Sean Leana (smleana)
+ * This file opens sockets and moves lines of text over them. Sends never raise
+ * SIGPIPE, so a worker that goes away is just a closed connection.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "connection.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+/** Initial size of the buffer for messages waiting to be sent. */
+#define INITIAL_OUT 256
+
+/** Longest host name in an address. */
+#define HOST_LIMIT 255
+
+/**
+ * Opens a socket for an address and binds or connects it.
+ * @param address the address
+ * @param server true to listen on the address, false to connect to it
+ * @return the socket, or -1 with errno set
+ */
+static int openSocket(char const *address, bool server)
+{
+    if (strncmp(address, UNIX_PREFIX, strlen(UNIX_PREFIX)) == 0) {
+        char const *path = address + strlen(UNIX_PREFIX);
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (*path == '\0' || strlen(path) >= sizeof(addr.sun_path)) {
+            errno = EINVAL;
+            return -1;
+        }
+        strcpy(addr.sun_path, path);
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) {
+            return -1;
+        }
+
+        // A socket left behind by an earlier coordinator would stop this one binding.
+        struct stat st;
+        if (server && stat(path, &st) == 0 && S_ISSOCK(st.st_mode)) {
+            unlink(path);
+        }
+        int status = server ? bind(fd, (struct sockaddr *) &addr, sizeof(addr))
+                            : connect(fd, (struct sockaddr *) &addr, sizeof(addr));
+        if (status != 0 || (server && listen(fd, SOMAXCONN) != 0)) {
+            int saved = errno;
+            close(fd);
+            errno = saved;
+            return -1;
+        }
+        return fd;
+    }
+
+    // Split host:port at the last colon, so the host can be an IPv6 address.
+    char const *colon = strrchr(address, ':');
+    if (colon == NULL || colon[1] == '\0' || colon - address > HOST_LIMIT) {
+        errno = EINVAL;
+        return -1;
+    }
+    char host[HOST_LIMIT + 1];
+    memcpy(host, address, colon - address);
+    host[colon - address] = '\0';
+
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = server ? AI_PASSIVE : 0;
+    struct addrinfo *list;
+    if (getaddrinfo(host[0] != '\0' ? host : NULL, colon + 1, &hints, &list) != 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    int fd = -1;
+    int saved = EINVAL;
+    for (struct addrinfo *ai = list; ai != NULL && fd < 0; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd < 0) {
+            saved = errno;
+            continue;
+        }
+        int on = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        int status = server ? bind(fd, ai->ai_addr, ai->ai_addrlen)
+                            : connect(fd, ai->ai_addr, ai->ai_addrlen);
+        if (status != 0 || (server && listen(fd, SOMAXCONN) != 0)) {
+            saved = errno;
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(list);
+    if (fd < 0) {
+        errno = saved;
+    }
+    return fd;
+}
+
+/**
+ * Listens on an address.
+ * @param address the address
+ * @return the listening socket, or -1 with errno set
+ */
+int listenAddress(char const *address)
+{
+    return openSocket(address, true);
+}
+
+/**
+ * Connects to an address.
+ * @param address the address
+ * @return the connected socket, or -1 with errno set
+ */
+int connectAddress(char const *address)
+{
+    return openSocket(address, false);
+}
+
+/**
+ * Closes a listening socket.
+ * @param fd the socket
+ * @param address the address it listens on
+ */
+void closeListener(int fd, char const *address)
+{
+    close(fd);
+    if (strncmp(address, UNIX_PREFIX, strlen(UNIX_PREFIX)) == 0) {
+        unlink(address + strlen(UNIX_PREFIX));
+    }
+}
+
+/**
+ * Starts using a socket as a connection.
+ * @param conn the connection to initialize
+ * @param fd the socket
+ */
+void openConnection(Connection *conn, int fd)
+{
+    conn->fd = fd;
+    conn->start = 0;
+    conn->end = 0;
+    conn->outCapacity = INITIAL_OUT;
+    conn->out = (char *) malloc(conn->outCapacity);
+    conn->outLen = 0;
+}
+
+/**
+ * Receives the next message.
+ * @param conn the connection
+ * @param message where a pointer to the message is stored
+ * @return CONNECTION_MESSAGE, CONNECTION_WAITING or CONNECTION_CLOSED
+ */
+int receiveMessage(Connection *conn, char **message)
+{
+    while (true) {
+        char *newline = (char *) memchr(conn->in + conn->start, '\n', conn->end - conn->start);
+        if (newline != NULL) {
+            *newline = '\0';
+            *message = conn->in + conn->start;
+            conn->start = newline + 1 - conn->in;
+            return CONNECTION_MESSAGE;
+        }
+
+        // A message that fills the whole buffer is too long to ever finish.
+        if (conn->start == 0 && conn->end == MESSAGE_LIMIT) {
+            return CONNECTION_CLOSED;
+        }
+        memmove(conn->in, conn->in + conn->start, conn->end - conn->start);
+        conn->end -= conn->start;
+        conn->start = 0;
+
+        ssize_t n = read(conn->fd, conn->in + conn->end, MESSAGE_LIMIT - conn->end);
+        if (n > 0) {
+            conn->end += n;
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return CONNECTION_WAITING;
+        } else if (n == 0 || errno != EINTR) {
+            return CONNECTION_CLOSED;
+        }
+    }
+}
+
+/**
+ * Adds a message to the ones waiting to be sent.
+ * @param conn the connection
+ * @param format the message, formatted like printf, with its newline
+ */
+void sendMessage(Connection *conn, char const *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(conn->out + conn->outLen, conn->outCapacity - conn->outLen,
+                        format, args);
+    va_end(args);
+    if (conn->outLen + len + 1 > conn->outCapacity) {
+        while (conn->outLen + len + 1 > conn->outCapacity) {
+            conn->outCapacity *= 2;
+        }
+        conn->out = (char *) realloc(conn->out, conn->outCapacity);
+        va_start(args, format);
+        vsnprintf(conn->out + conn->outLen, conn->outCapacity - conn->outLen, format, args);
+        va_end(args);
+    }
+    conn->outLen += len;
+}
+
+/**
+ * Sends the messages waiting to be sent.
+ * @param conn the connection
+ * @return false if the other side has gone
+ */
+bool flushConnection(Connection *conn)
+{
+    size_t sent = 0;
+    while (sent < conn->outLen) {
+        ssize_t n = send(conn->fd, conn->out + sent, conn->outLen - sent, MSG_NOSIGNAL);
+        if (n >= 0) {
+            sent += n;
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            break;
+        } else if (errno != EINTR) {
+            return false;
+        }
+    }
+    memmove(conn->out, conn->out + sent, conn->outLen - sent);
+    conn->outLen -= sent;
+    return true;
+}
+
+/**
+ * Closes a connection.
+ * @param conn the connection
+ */
+void closeConnection(Connection *conn)
+{
+    close(conn->fd);
+    free(conn->out);
+    conn->out = NULL;
+}
@@ -0,0 +1,78 @@
+/**
+ * @file connection.h
+ * @author Sean Leana (smleana)
+ * This file defines the connections between a coordinator and its workers. They
+ * talk in lines of text over a TCP or Unix socket, and each side reads and writes
+ * through buffers, so the coordinator can serve many workers from one thread without
+ * ever waiting on a slow one.
+ *
+ * An address is either host:port, for TCP, or unix:path, for a Unix socket. A
+ * coordinator can leave out the host to listen on every interface.
+ */
+
+#ifndef _CONNECTION_H_
+#define _CONNECTION_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/** Longest message a connection can receive, with its newline. */
+#define MESSAGE_LIMIT 8192
+
+/** Prefix of an address for a Unix socket. */
+#define UNIX_PREFIX "unix:"
+
+/** Result of receiveMessage() when it received a message. */
+#define CONNECTION_MESSAGE 1
+
+/** Result of receiveMessage() when a non-blocking connection has no whole message
+    yet. */
+#define CONNECTION_WAITING 0
+
+/** Result of receiveMessage() when the other side has gone, or broke the protocol. */
+#define CONNECTION_CLOSED -1
+
+/** One side of a connection. */
+typedef struct {
+    /** The socket. */
+    int fd;
+
+    /** Buffer messages are received into, and the part of it not used yet. */
+    char in[ MESSAGE_LIMIT ];
+    size_t start;
+    size_t end;
+
+    /** Messages waiting to be sent. */
+    char *out;
+    size_t outLen;
+    size_t outCapacity;
+} Connection;
+
+/** listens on the given address. Returns the socket, or -1 with errno set. */
+int listenAddress( char const *address );
+
+/** connects to the given address. Returns the socket, or -1 with errno set. */
+int connectAddress( char const *address );
+
+/** closes a listening socket, removing it from the file system if it's a Unix socket */
+void closeListener( int fd, char const *address );
+
+/** starts using the given socket as a connection */
+void openConnection( Connection *conn, int fd );
+
+/** receives the next message, without its newline, storing a pointer to it that's
+ * good until the next call. On a blocking socket, this waits for the message. Returns
+ * CONNECTION_MESSAGE, CONNECTION_WAITING or CONNECTION_CLOSED. */
+int receiveMessage( Connection *conn, char **message );
+
+/** adds a message, formatted like printf, to the ones waiting to be sent */
+void sendMessage( Connection *conn, char const *format, ... );
+
+/** sends as much of the waiting messages as the socket takes; on a blocking socket,
+ * that's all of them. Returns false if the other side has gone. */
+bool flushConnection( Connection *conn );
+
+/** closes the socket and frees the buffers */
+void closeConnection( Connection *conn );
+
+#endif
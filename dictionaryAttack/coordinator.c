@@ -0,0 +1,318 @@
+/**
+ * @file coordinator.c
+ * @author Sean Leana (smleana)
+ * This file runs a coordinator. One thread serves every worker through poll(), and
+ * each message costs it a few microseconds, against the seconds of hashing a lease
+ * stands for, so dozens of workers barely keep it busy. A worker that goes away just
+ * lets its leases expire straight away, and a password a worker reports is hashed
+ * again before it's believed.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "coordinator.h"
+#include "connection.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+/** Number of milliseconds to wait for a worker before looking at the time again. */
+#define POLL_MILLIS 1000
+
+/** A connected worker. */
+typedef struct {
+    /** The connection to the worker. */
+    Connection conn;
+
+    /** Number that identifies the worker, for its leases. */
+    int id;
+
+    /** Whether the worker has joined the job. */
+    bool joined;
+
+    /** Number of cracked passwords the worker has been told about. */
+    int sent;
+
+    /** Set once the worker is to be disconnected, after its messages are sent. */
+    bool closing;
+} Client;
+
+/**
+ * Returns the current time in seconds, on a clock that doesn't jump.
+ * @return the time
+ */
+static time_t now()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec;
+}
+
+/**
+ * Sets up a job.
+ * @param coord the coordinator to initialize
+ * @param targets the users being cracked
+ * @param job description of the job, which the workers' has to match
+ * @param keyspace number of candidates in the job
+ * @param timeout number of seconds a worker has to finish a lease
+ * @param pot potfile for newly cracked passwords, or NULL
+ */
+void initCoordinator(Coordinator *coord, TargetSet const *targets, char const *job,
+                     long long keyspace, int timeout, Potfile *pot)
+{
+    coord->targets = targets;
+    coord->job = job;
+    initLeases(&coord->leases, keyspace, timeout);
+    coord->found = (bool *) calloc(targets->digestCount + 1, sizeof(bool));
+    coord->passwords = (char (*)[PW_LIMIT + 1]) calloc(targets->digestCount + 1,
+                                                       PW_LIMIT + 1);
+    coord->cracked = (int *) calloc(targets->digestCount + 1, sizeof(int));
+    coord->crackedCount = 0;
+    coord->pot = pot;
+    coord->workers = 0;
+}
+
+/**
+ * Records a password that's already known.
+ * @param coord the coordinator
+ * @param digest index of the digest
+ * @param password its password
+ */
+void knownDigest(Coordinator *coord, int digest, char const *password)
+{
+    if (!coord->found[digest]) {
+        coord->found[digest] = true;
+        strcpy(coord->passwords[digest], password);
+        coord->cracked[coord->crackedCount++] = digest;
+    }
+}
+
+/**
+ * Reports whether there's nothing left for the workers to do.
+ * @param coord the coordinator
+ * @return true once every candidate is hashed or every digest cracked
+ */
+static bool jobDone(Coordinator const *coord)
+{
+    return coord->crackedCount == coord->targets->digestCount || leasesDone(&coord->leases);
+}
+
+/**
+ * Records a password a worker cracked, if it really is the digest's password.
+ * @param coord the coordinator
+ * @param digest index of the digest
+ * @param password the password
+ * @return false if the password doesn't hash to the digest
+ */
+static bool reportCrack(Coordinator *coord, int digest, char const *password)
+{
+    TargetSet const *targets = coord->targets;
+    Digest const *d = &targets->digests[digest];
+    char const *salt = targets->groups[d->group].salt;
+    char str[PW_HASH_LIMIT + 1];
+    byte hash[HASH_SIZE];
+    hashPassword(password, salt, str);
+    if (!stringToHash(str, hash) || memcmp(hash, d->hash, HASH_SIZE) != 0) {
+        return false;
+    }
+    if (!coord->found[digest]) {
+        knownDigest(coord, digest, password);
+        if (coord->pot != NULL) {
+            addPot(coord->pot, salt, d->hash, password);
+            flushPot(coord->pot);
+        }
+    }
+    return true;
+}
+
+/**
+ * Answers one message from a worker.
+ * @param coord the coordinator
+ * @param client the worker
+ * @param message the message, without its newline
+ * @return false if the message breaks the protocol
+ */
+static bool handleMessage(Coordinator *coord, Client *client, char *message)
+{
+    int digests;
+    long long number;
+    int n = 0;
+    if (sscanf(message, "hello %d %lld%n", &digests, &number, &n) == 2
+            && message[n] == ' ') {
+        if (digests != coord->targets->digestCount || number != coord->leases.keyspace
+                || strcmp(message + n + 1, coord->job) != 0) {
+            sendMessage(&client->conn, "error the coordinator is running a different job\n");
+            return false;
+        }
+        client->joined = true;
+        coord->workers++;
+        sendMessage(&client->conn, "ok %d\n", coord->leases.timeout);
+        return true;
+    }
+    if (!client->joined) {
+        return false;
+    }
+
+    if (sscanf(message, "lease %lld%n", &number, &n) == 1 && message[n] == '\0'
+            && number > 0) {
+        // Pass on what the others have cracked, so the worker stops looking for it.
+        for (; client->sent < coord->crackedCount; client->sent++) {
+            int d = coord->cracked[client->sent];
+            sendMessage(&client->conn, "cracked %d %s\n", d, coord->passwords[d]);
+        }
+        Lease lease;
+        if (jobDone(coord)) {
+            sendMessage(&client->conn, "done\n");
+        } else if (grantLease(&coord->leases, client->id, number, now(), &lease)) {
+            sendMessage(&client->conn, "range %lld %lld %lld\n", lease.id, lease.start,
+                        lease.end);
+        } else {
+            sendMessage(&client->conn, "wait\n");
+        }
+        return true;
+    }
+    if (sscanf(message, "cracked %d%n", &digests, &n) == 1 && message[n] == ' ') {
+        char const *password = message + n + 1;
+        return digests >= 0 && digests < coord->targets->digestCount
+            && strlen(password) <= PW_LIMIT && reportCrack(coord, digests, password);
+    }
+    if (sscanf(message, "finished %lld%n", &number, &n) == 1 && message[n] == '\0') {
+        // A lease that expired and was finished by someone else is already gone.
+        finishLease(&coord->leases, number);
+        return true;
+    }
+    return false;
+}
+
+/**
+ * Reads and answers everything a worker has sent.
+ * @param coord the coordinator
+ * @param client the worker
+ * @return false if the worker has gone or has to be disconnected
+ */
+static bool serveClient(Coordinator *coord, Client *client)
+{
+    char *message;
+    int status = CONNECTION_WAITING;
+    while (!client->closing
+           && (status = receiveMessage(&client->conn, &message)) == CONNECTION_MESSAGE) {
+        if (!handleMessage(coord, client, message)) {
+            client->closing = true;
+        }
+    }
+    bool sent = flushConnection(&client->conn);
+    if (client->closing) {
+        return false;
+    }
+    return sent && status != CONNECTION_CLOSED;
+}
+
+/**
+ * Makes a socket non-blocking.
+ * @param fd the socket
+ */
+static void setNonBlocking(int fd)
+{
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+}
+
+/**
+ * Serves workers until the job is done and they've all been told, or until they've
+ * had a lease's time to hear about it.
+ * @param coord the coordinator
+ * @param listener the listening socket
+ */
+void serveJob(Coordinator *coord, int listener)
+{
+    setNonBlocking(listener);
+    int capacity = 16;
+    Client *clients = (Client *) malloc(capacity * sizeof(Client));
+    struct pollfd *fds = (struct pollfd *) malloc((capacity + 1) * sizeof(struct pollfd));
+    int count = 0;
+    int nextId = 1;
+    time_t doneAt = 0;
+
+    while (true) {
+        if (jobDone(coord) && doneAt == 0) {
+            doneAt = now();
+        }
+        if (doneAt != 0 && (count == 0 || now() - doneAt >= coord->leases.timeout)) {
+            break;
+        }
+
+        fds[0].fd = listener;
+        fds[0].events = POLLIN;
+        for (int i = 0; i < count; i++) {
+            fds[i + 1].fd = clients[i].conn.fd;
+            fds[i + 1].events = POLLIN | (clients[i].conn.outLen > 0 ? POLLOUT : 0);
+        }
+        if (poll(fds, count + 1, POLL_MILLIS) < 0) {
+            continue;
+        }
+
+        // Serve the workers before letting more in, so the indexes still line up.
+        for (int i = count - 1; i >= 0; i--) {
+            if (fds[i + 1].revents != 0 && !serveClient(coord, &clients[i])) {
+                dropOwner(&coord->leases, clients[i].id);
+                closeConnection(&clients[i].conn);
+                clients[i] = clients[--count];
+            }
+        }
+
+        if (fds[0].revents & POLLIN) {
+            int fd;
+            while ((fd = accept(listener, NULL, NULL)) >= 0) {
+                if (count == capacity) {
+                    capacity *= 2;
+                    clients = (Client *) realloc(clients, capacity * sizeof(Client));
+                    fds = (struct pollfd *) realloc(fds, (capacity + 1) * sizeof(struct pollfd));
+                }
+                setNonBlocking(fd);
+                Client *client = &clients[count++];
+                openConnection(&client->conn, fd);
+                client->id = nextId++;
+                client->joined = false;
+                client->sent = 0;
+                client->closing = false;
+            }
+        }
+    }
+
+    for (int i = 0; i < count; i++) {
+        closeConnection(&clients[i].conn);
+    }
+    free(clients);
+    free(fds);
+}
+
+/**
+ * Writes the cracked users.
+ * @param coord the coordinator
+ * @param out the stream to write to
+ */
+void writeCoordinated(Coordinator const *coord, FILE *out)
+{
+    TargetSet const *targets = coord->targets;
+    for (int u = 0; u < targets->userCount; u++) {
+        int d = targets->users[u].digest;
+        if (coord->found[d]) {
+            fprintf(out, "%s : %s\n", targets->users[u].name, coord->passwords[d]);
+        }
+    }
+}
+
+/**
+ * Frees a coordinator.
+ * @param coord the coordinator
+ */
+void freeCoordinator(Coordinator *coord)
+{
+    freeLeases(&coord->leases);
+    free(coord->found);
+    free(coord->passwords);
+    free(coord->cracked);
+}
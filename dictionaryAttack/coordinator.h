@@ -0,0 +1,72 @@
+/**
+ * @file coordinator.h
+ * @author Sean Leana (smleana)
+ * This file defines the coordinator of a job spread over worker processes. Workers
+ * connect, check that they're running the same job, and then ask for leases on
+ * ranges of candidates, reporting what they cracked as they finish each one. Every
+ * password cracked anywhere is passed on to the other workers with their next lease,
+ * so they stop looking for it too. The conversation is in lines of text:
+ *
+ *   worker: hello <digests> <keyspace> <job>     coordinator: ok <timeout>, or
+ *                                                             error <reason>
+ *   worker: lease <size>                         coordinator: cracked <digest> <password>
+ *                                                             ...
+ *                                                             range <id> <start> <end>,
+ *                                                             wait, or done
+ *   worker: cracked <digest> <password>
+ *           ...
+ *           finished <id>
+ */
+
+#ifndef _COORDINATOR_H_
+#define _COORDINATOR_H_
+
+#include "target.h"
+#include "lease.h"
+#include "potfile.h"
+#include <stdbool.h>
+#include <stdio.h>
+
+/** A job being handed out to workers. */
+typedef struct {
+    /** The users being cracked, and a description of the job. */
+    TargetSet const *targets;
+    char const *job;
+
+    /** The leases on the job's candidates. */
+    LeaseTable leases;
+
+    /** Whether each digest is cracked and its password, and the digests in the order
+        they were cracked. */
+    bool *found;
+    char (*passwords)[PW_LIMIT + 1];
+    int *cracked;
+    int crackedCount;
+
+    /** Potfile for newly cracked passwords, or NULL. */
+    Potfile *pot;
+
+    /** Number of workers that have joined the job. */
+    int workers;
+} Coordinator;
+
+/** starts a job with the given candidates, and the given number of seconds for a
+ * worker to finish each lease, appending newly cracked passwords to pot unless it's
+ * NULL */
+void initCoordinator( Coordinator *coord, TargetSet const *targets, char const *job,
+                      long long keyspace, int timeout, Potfile *pot );
+
+/** records a password that's already known, like one from the potfile */
+void knownDigest( Coordinator *coord, int digest, char const *password );
+
+/** serves workers on the given listening socket until every candidate has been
+ * hashed or every digest cracked, and the workers still connected have been told */
+void serveJob( Coordinator *coord, int listener );
+
+/** writes every cracked user, in shadow file order */
+void writeCoordinated( Coordinator const *coord, FILE *out );
+
+/** frees the coordinator */
+void freeCoordinator( Coordinator *coord );
+
+#endif
@@ -4,23 +4,38 @@
  * This program makes a dictionary attack against a file including users information includinghashes
  */
 
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdbool.h>
 #include <string.h>
 #include "password.h"
-
-/** Maximum username length */
-#define USERNAME_LIMIT 32
-
-/** Maximum number of words we can have in the dictionary. */
-#define DLIST_LIMIT 1000
+#include "md5.h"
+#include "target.h"
+#include "engine.h"
+#include "dictionary.h"
+#include "shadow.h"
+#include "feed.h"
+#include "rules.h"
+#include "mask.h"
+#include "dedup.h"
+#include "potfile.h"
+#include "checkpoint.h"
+#include "merge.h"
+#include "connection.h"
+#include "coordinator.h"
+#include "remote.h"
+#include <time.h>
+#include <limits.h>
+#include <unistd.h>
+#include <signal.h>
 
 /** Number of required arguments on the command line. */
 #define REQ_ARGS 2
 
-/** Type for representing a word in the dictionary. */
-typedef char Password[PW_LIMIT + 1];
+/** Dictionary name that means the words come from standard input. */
+#define STDIN_NAME "-"
 
 /** Print out a usage message and exit unsuccessfully. */
 static void usage()
@@ -29,170 +44,878 @@ static void usage()
     exit( EXIT_FAILURE);
 }
 
+/** Prefix of the option used to pin a particular md5 kernel. */
+#define KERNEL_OPTION "--kernel="
+
+/** Option giving the number of worker threads. */
+#define THREADS_OPTION "-j"
+
+/** Option that reports how much hashing was done, and how fast, to standard error. */
+#define STATS_OPTION "--stats"
+
+/** Option that reads the dictionary from standard input, like a dictionary named -. */
+#define STDIN_OPTION "--stdin"
+
+/** Prefix of the option giving a file of rules to expand each dictionary word with. */
+#define RULES_OPTION "--rules="
+
+/** Prefix of the option giving a mask to brute-force instead of using a dictionary. */
+#define MASK_OPTION "--mask="
+
+/** Option that tries every prefix of the mask, shortest first. */
+#define INCREMENT_OPTION "--increment"
+
+/** Option that pairs every word of one dictionary with every word of another. */
+#define COMBINATOR_OPTION "--combinator"
+
+/** Option that skips candidates that have already been tried. It can be followed by
+    =exact or =bloom to pick the filter; otherwise streams get a Bloom filter, since
+    they have no end in sight, and everything else gets an exact one. */
+#define DEDUP_OPTION "--dedup"
+
+/** Prefix of the option giving the size of a Bloom filter, in megabytes. */
+#define DEDUP_MEMORY_OPTION "--dedup-memory="
+
+/** Filter mode that picks DEDUP_EXACT or DEDUP_BLOOM depending on the source. */
+#define DEDUP_AUTO -1
+
+/** Option that loops every cracked password back in as a candidate. */
+#define LOOPBACK_OPTION "--loopback"
+
+/** Prefix of the option giving a file of rules to make variants of each cracked
+    password with; it turns on loopback too. */
+#define LOOPBACK_RULES_OPTION "--loopback-rules="
+
+/** Prefix of the option giving a potfile, which remembers cracked passwords from one
+    run to the next. */
+#define POTFILE_OPTION "--potfile="
+
+/** Prefix of the option giving the file checkpoints are saved in. */
+#define CHECKPOINT_OPTION "--checkpoint="
+
+/** Prefix of the option giving the number of seconds between checkpoints. */
+#define CHECKPOINT_INTERVAL_OPTION "--checkpoint-interval="
+
+/** Option that picks up from the last checkpoint. */
+#define RESTORE_OPTION "--restore"
+
+/** Checkpoint file used with --restore when no other one is given. */
+#define CHECKPOINT_NAME "crack.checkpoint"
+
+/** Option that runs only one shard of the job, given as i/N. */
+#define SHARD_OPTION "--shard"
+
+/** Largest number of shards a job can be split into. */
+#define SHARD_LIMIT 100000
+
+/** Option that merges the output of a sharded job instead of cracking anything. */
+#define MERGE_OPTION "--merge"
+
+/** Prefix of the option that hands the job out to workers from the given address. */
+#define SERVE_OPTION "--serve="
+
+/** Prefix of the option that works on leases from the coordinator at the given
+    address. */
+#define WORKER_OPTION "--worker="
+
+/** Prefix of the option giving the number of seconds a worker has to finish a lease. */
+#define LEASE_TIMEOUT_OPTION "--lease-timeout="
+
+/** Number of seconds of hashing a worker asks for in each lease, at most. A lease
+    also lasts no more than a quarter of the time the coordinator gives for it. */
+#define LEASE_TARGET_SECONDS 5.0
+
+/** Number of candidates a worker asks for in its first lease, for each thread. */
+#define FIRST_LEASE (BATCH_WORDS * 4)
+
+/** Number of nanoseconds a worker waits before asking again when every candidate
+    is leased. */
+#define WAIT_NANOS 250000000L
+
+/** Largest length of the description of a job kept in its checkpoints. */
+#define JOB_LIMIT 4000
+
+/** Candidates come from a dictionary file. */
+#define SOURCE_DICTIONARY 0
+
+/** Candidates come from standard input. */
+#define SOURCE_STDIN 1
+
+/** Candidates come from a mask. */
+#define SOURCE_MASK 2
+
+/** Candidates are pairs of words from two dictionaries. */
+#define SOURCE_COMBINATOR 3
+
+/** Nothing is cracked; the output of a sharded job's shards is merged. */
+#define SOURCE_MERGE 4
+
+/** Everything given on the command line. */
+typedef struct {
+    /** Where the candidates come from. */
+    int source;
+
+    /** Name of the dictionary file, for SOURCE_DICTIONARY, or of the dictionary of
+        first halves, for SOURCE_COMBINATOR. */
+    char const *dictionaryName;
+
+    /** Name of the dictionary of second halves, for SOURCE_COMBINATOR. */
+    char const *rightName;
+
+    /** The mask, for SOURCE_MASK, and whether to run it incrementally. */
+    char const *maskText;
+    bool increment;
+
+    /** Name of the shadow file. */
+    char const *shadowName;
+
+    /** Every file name on the command line; for SOURCE_MERGE, the ones after the
+        shadow file are the shards' output files. */
+    char const **files;
+    int fileCount;
+
+    /** Which shard of the job to run, from 1, and the number of shards. */
+    int shard;
+    int shards;
+
+    /** Address to hand the job out from, or of the coordinator to work for, or NULL,
+        and the number of seconds a worker has to finish a lease. */
+    char const *serveAddress;
+    char const *workerAddress;
+    int leaseTimeout;
+
+    /** Name of the rule file, or NULL. */
+    char const *rulesName;
+
+    /** Whether cracked passwords are looped back, and the name of the file of rules
+        for their variants, or NULL. */
+    bool loopback;
+    char const *loopRulesName;
+
+    /** Name of the potfile, or NULL. */
+    char const *potName;
+
+    /** Name of the checkpoint file, or NULL, the number of seconds between
+        checkpoints, and whether to pick up from the last one. */
+    char const *checkpointName;
+    int checkpointInterval;
+    bool restore;
+
+    /** Name of the md5 kernel to use, or NULL to pick the best one. */
+    char const *kernelName;
+
+    /** Number of worker threads. */
+    int threads;
+
+    /** Whether to report statistics at the end. */
+    bool stats;
+
+    /** How duplicate candidates are filtered, and how much memory a Bloom filter
+        can use. */
+    int dedupMode;
+    size_t bloomBytes;
+} Options;
+
 /**
- * read line reads in a file and parses it until EOF or EOL
- * @param fp the file to be read
- * @return the string read
+ * Parses the number of threads given with -j.
+ * @param str the number, as a string
+ * @return the number of threads, or exits with a usage message if it's not valid
  */
-char* readLine(FILE *fp)
+static int parseThreads(char const *str)
 {
-    if (fp == NULL) {
-        fp = stdin;
+    char *end;
+    long n = strtol(str, &end, 10);
+    if (*str == '\0' || *end != '\0' || n < 1 || n > 4096) {
+        usage();
     }
+    return (int) n;
+}
 
-    char ch = 0;
-    if ((ch = fgetc(fp)) == EOF) {
-        return NULL;
-    } else {
-        ungetc(ch, fp);
-    }
-
-    int capacity = 5;
-    char *line = (char*) malloc(capacity * sizeof(char));
-    int len = 0;
-    while ((ch = fgetc(fp)) != '\n' && ch != EOF) {
-        if (len >= capacity) {
-            capacity *= 2;
-            char *newLine = (char*) malloc(capacity * sizeof(char));
-            for (int i = 0; i < len; i++) {
-                newLine[i] = line[i];
+/**
+ * Parses the shard given with --shard, as i/N.
+ * @param str the shard, as a string
+ * @param opts where the shard and number of shards are stored; exits with a usage
+ * message if it's not valid
+ */
+static void parseShard(char const *str, Options *opts)
+{
+    char extra;
+    if (sscanf(str, "%d/%d%c", &opts->shard, &opts->shards, &extra) != 2
+            || opts->shards < 1 || opts->shards > SHARD_LIMIT
+            || opts->shard < 1 || opts->shard > opts->shards) {
+        usage();
+    }
+}
+
+/** Set by the signal handler when the job is asked to stop. */
+static volatile sig_atomic_t stopRequested = 0;
+
+/**
+ * Asks the job to stop at the next batch, so it can save a checkpoint first. The
+ * handler is reset, so a second signal stops the job straight away.
+ * @param sig the signal
+ */
+static void requestStop(int sig)
+{
+    (void) sig;
+    stopRequested = 1;
+}
+
+/**
+ * Parses the number of seconds between checkpoints.
+ * @param str the number, as a string
+ * @return the number of seconds, or exits with a usage message if it's not valid
+ */
+static int parseSeconds(char const *str)
+{
+    char *end;
+    long n = strtol(str, &end, 10);
+    if (*str == '\0' || *end != '\0' || n < 0 || n > 86400) {
+        usage();
+    }
+    return (int) n;
+}
+
+/**
+ * Parses the size of a Bloom filter given with --dedup-memory=.
+ * @param str the number of megabytes, as a string
+ * @return the number of bytes, or exits with a usage message if it's not valid
+ */
+static size_t parseMegabytes(char const *str)
+{
+    char *end;
+    long n = strtol(str, &end, 10);
+    if (*str == '\0' || *end != '\0' || n < 1 || n > 65536) {
+        usage();
+    }
+    return (size_t) n << 20;
+}
+
+/**
+ * Parses the command line, exiting with a usage message if it isn't valid. The file
+ * names are whatever isn't an option, in order: the dictionary, or two of them for
+ * the combinator, unless the candidates come from somewhere else, and then the
+ * shadow file. A merge takes the shadow file first, then the shards' output files.
+ * @param argc number of command-line arguments
+ * @param argv the command-line arguments
+ * @param opts where the options are stored
+ */
+static void parseOptions(int argc, char *argv[], Options *opts)
+{
+    memset(opts, 0, sizeof(Options));
+    opts->source = SOURCE_DICTIONARY;
+    opts->threads = onlineCpus();
+    opts->dedupMode = DEDUP_OFF;
+    opts->bloomBytes = DEDUP_BLOOM_BYTES;
+    opts->checkpointInterval = CHECKPOINT_SECONDS;
+    opts->shard = 1;
+    opts->shards = 1;
+    opts->leaseTimeout = LEASE_SECONDS;
+
+    char const **files = (char const **) malloc(argc * sizeof(char const *));
+    int fileCount = 0;
+    opts->files = files;
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], KERNEL_OPTION, strlen(KERNEL_OPTION)) == 0) {
+            opts->kernelName = argv[i] + strlen(KERNEL_OPTION);
+        } else if (strcmp(argv[i], THREADS_OPTION) == 0 && i + 1 < argc) {
+            opts->threads = parseThreads(argv[++i]);
+        } else if (strncmp(argv[i], THREADS_OPTION, strlen(THREADS_OPTION)) == 0
+                && argv[i][strlen(THREADS_OPTION)] >= '0' && argv[i][strlen(THREADS_OPTION)] <= '9') {
+            opts->threads = parseThreads(argv[i] + strlen(THREADS_OPTION));
+        } else if (strcmp(argv[i], STATS_OPTION) == 0) {
+            opts->stats = true;
+        } else if (strcmp(argv[i], STDIN_OPTION) == 0) {
+            opts->source = SOURCE_STDIN;
+        } else if (strncmp(argv[i], RULES_OPTION, strlen(RULES_OPTION)) == 0) {
+            opts->rulesName = argv[i] + strlen(RULES_OPTION);
+        } else if (strncmp(argv[i], MASK_OPTION, strlen(MASK_OPTION)) == 0) {
+            opts->source = SOURCE_MASK;
+            opts->maskText = argv[i] + strlen(MASK_OPTION);
+        } else if (strcmp(argv[i], INCREMENT_OPTION) == 0) {
+            opts->increment = true;
+        } else if (strcmp(argv[i], COMBINATOR_OPTION) == 0) {
+            opts->source = SOURCE_COMBINATOR;
+        } else if (strncmp(argv[i], POTFILE_OPTION, strlen(POTFILE_OPTION)) == 0) {
+            opts->potName = argv[i] + strlen(POTFILE_OPTION);
+        } else if (strncmp(argv[i], CHECKPOINT_OPTION, strlen(CHECKPOINT_OPTION)) == 0) {
+            opts->checkpointName = argv[i] + strlen(CHECKPOINT_OPTION);
+        } else if (strncmp(argv[i], CHECKPOINT_INTERVAL_OPTION,
+                           strlen(CHECKPOINT_INTERVAL_OPTION)) == 0) {
+            opts->checkpointInterval = parseSeconds(argv[i] + strlen(CHECKPOINT_INTERVAL_OPTION));
+        } else if (strcmp(argv[i], RESTORE_OPTION) == 0) {
+            opts->restore = true;
+        } else if (strcmp(argv[i], LOOPBACK_OPTION) == 0) {
+            opts->loopback = true;
+        } else if (strncmp(argv[i], LOOPBACK_RULES_OPTION, strlen(LOOPBACK_RULES_OPTION)) == 0) {
+            opts->loopback = true;
+            opts->loopRulesName = argv[i] + strlen(LOOPBACK_RULES_OPTION);
+        } else if (strcmp(argv[i], DEDUP_OPTION) == 0) {
+            opts->dedupMode = DEDUP_AUTO;
+        } else if (strcmp(argv[i], DEDUP_OPTION "=exact") == 0) {
+            opts->dedupMode = DEDUP_EXACT;
+        } else if (strcmp(argv[i], DEDUP_OPTION "=bloom") == 0) {
+            opts->dedupMode = DEDUP_BLOOM;
+        } else if (strncmp(argv[i], DEDUP_MEMORY_OPTION, strlen(DEDUP_MEMORY_OPTION)) == 0) {
+            opts->bloomBytes = parseMegabytes(argv[i] + strlen(DEDUP_MEMORY_OPTION));
+        } else if (strcmp(argv[i], SHARD_OPTION) == 0 && i + 1 < argc) {
+            parseShard(argv[++i], opts);
+        } else if (strncmp(argv[i], SHARD_OPTION "=", strlen(SHARD_OPTION "=")) == 0) {
+            parseShard(argv[i] + strlen(SHARD_OPTION "="), opts);
+        } else if (strcmp(argv[i], MERGE_OPTION) == 0) {
+            opts->source = SOURCE_MERGE;
+        } else if (strncmp(argv[i], SERVE_OPTION, strlen(SERVE_OPTION)) == 0) {
+            opts->serveAddress = argv[i] + strlen(SERVE_OPTION);
+        } else if (strncmp(argv[i], WORKER_OPTION, strlen(WORKER_OPTION)) == 0) {
+            opts->workerAddress = argv[i] + strlen(WORKER_OPTION);
+        } else if (strncmp(argv[i], LEASE_TIMEOUT_OPTION, strlen(LEASE_TIMEOUT_OPTION)) == 0) {
+            opts->leaseTimeout = parseSeconds(argv[i] + strlen(LEASE_TIMEOUT_OPTION));
+            if (opts->leaseTimeout == 0) {
+                usage();
             }
-            free(line);
-            line = newLine;
+        } else {
+            files[fileCount++] = argv[i];
         }
-        line[len++] = ch;
     }
-    line[len] = '\0';
-    return line;
+    opts->fileCount = fileCount;
+
+    if (opts->source == SOURCE_MERGE) {
+        if (fileCount < REQ_ARGS) {
+            usage();
+        }
+        opts->shadowName = files[0];
+        return;
+    }
+
+    // Only dictionary files need names; the shadow file always comes last.
+    int needed = REQ_ARGS - 1;
+    if (opts->source == SOURCE_DICTIONARY) {
+        needed = REQ_ARGS;
+    } else if (opts->source == SOURCE_COMBINATOR) {
+        needed = REQ_ARGS + 1;
+    }
+    // A mask makes its candidates directly, so there are no words for rules to expand.
+    if (fileCount != needed || (opts->increment && opts->source != SOURCE_MASK) ||
+        (opts->source == SOURCE_MASK && opts->rulesName != NULL)) {
+        usage();
+    }
+    opts->shadowName = files[fileCount - 1];
+    if (opts->source == SOURCE_DICTIONARY) {
+        opts->dictionaryName = files[0];
+        if (strcmp(files[0], STDIN_NAME) == 0) {
+            opts->source = SOURCE_STDIN;
+        }
+    } else if (opts->source == SOURCE_COMBINATOR) {
+        opts->dictionaryName = files[0];
+        opts->rightName = files[1];
+    }
+    if (opts->restore && opts->checkpointName == NULL) {
+        opts->checkpointName = CHECKPOINT_NAME;
+    }
+
+    // A job spread over workers needs an end to lease out, and its progress lives in
+    // the coordinator rather than in checkpoints or shards.
+    if ((opts->serveAddress != NULL || opts->workerAddress != NULL)
+            && ((opts->serveAddress != NULL && opts->workerAddress != NULL)
+                || opts->source == SOURCE_STDIN || opts->checkpointName != NULL
+                || opts->loopback || opts->shards > 1)) {
+        usage();
+    }
+    if (opts->dedupMode == DEDUP_AUTO) {
+        opts->dedupMode = opts->source == SOURCE_STDIN ? DEDUP_BLOOM : DEDUP_EXACT;
+    }
 }
 
 /**
- * read word reads in a word and parses it until EOF or EOL or a space
- * @param fp the file to be read
- * @return the word read
+ * Describes everything that decides which candidates a job generates, and in what
+ * order, so a checkpoint is only ever restored into the job it came from.
+ * @param opts the options
+ * @param job where the description is stored
  */
-char* readWord(FILE *fp)
+static void describeJob(Options const *opts, char job[JOB_LIMIT + 1])
 {
-    if (fp == NULL) {
-        fp = stdin;
+    snprintf(job, JOB_LIMIT + 1, "source=%d dictionary=%s right=%s mask=%s increment=%d "
+             "rules=%s shadow=%s shard=%d/%d", opts->source,
+             opts->dictionaryName ? opts->dictionaryName : "-",
+             opts->rightName ? opts->rightName : "-", opts->maskText ? opts->maskText : "-",
+             opts->increment, opts->rulesName ? opts->rulesName : "-", opts->shadowName,
+             opts->shard, opts->shards);
+}
+
+/**
+ * Reads the checkpoint to restore, exiting if it can't be used.
+ * @param opts the options
+ * @param job description of this job
+ * @param cracked table the passwords cracked before the checkpoint are added to
+ * @return the cursor to pick up from
+ */
+static long long restoreCheckpoint(Options const *opts, char const *job, Potfile *cracked)
+{
+    long long cursor = 0;
+    int status = loadCheckpoint(opts->checkpointName, job, &cursor, cracked);
+    if (status == CHECKPOINT_UNREADABLE) {
+        perror(opts->checkpointName);
+        exit(1);
+    } else if (status == CHECKPOINT_INVALID) {
+        fprintf(stderr, "Invalid checkpoint: %s\n", opts->checkpointName);
+        exit(1);
+    } else if (status == CHECKPOINT_MISMATCH) {
+        fprintf(stderr, "Checkpoint %s is for a different job\n", opts->checkpointName);
+        exit(1);
     }
+    return cursor;
+}
 
-    char ch = 0;
-    if ((ch = fgetc(fp)) == EOF) {
-        return NULL;
+/**
+ * Loads a file of rules, unless there isn't one, exiting if it can't be read or has
+ * an invalid rule.
+ * @param filename name of the rule file, or NULL
+ * @param rules the rule set to load the rules into
+ */
+static void loadRuleFile(char const *filename, RuleSet *rules)
+{
+    int line;
+    if (filename != NULL && !loadRules(rules, filename, &line)) {
+        if (line == 0) {
+            perror(filename);
+        } else {
+            fprintf(stderr, "Invalid rule on line %d of %s\n", line, filename);
+        }
+        exit(1);
+    }
+}
+
+/**
+ * Loads a dictionary file, exiting if it can't be read or has an invalid word.
+ * @param filename name of the dictionary file
+ * @param dict the dictionary to load
+ * @param threads number of threads to load it with
+ */
+static void loadDictionary(char const *filename, Dictionary *dict, int threads)
+{
+    if (!openDictionary(dict, filename)) {
+        perror(filename);
+        exit(1);
+    }
+    if (!indexDictionary(dict, threads)) {
+        fprintf(stderr, "Invalid dictionary word\n");
+        exit(1);
+    }
+}
+
+/**
+ * Reads the users to crack from a shadow file, exiting if it can't be read or has an
+ * invalid entry.
+ * @param filename name of the shadow file
+ * @param targets the target set the users are added to
+ */
+static void loadTargets(char const *filename, TargetSet *targets)
+{
+    ShadowFile shadow;
+    if (!openShadow(&shadow, filename)) {
+        perror(filename);
+        exit(1);
+    }
+
+    ShadowEntry entry;
+    int status;
+    while ((status = readShadowEntry(&shadow, &entry)) == SHADOW_ENTRY) {
+        // Decode the target once, so candidates can be compared as raw hash values.
+        byte target[HASH_SIZE];
+        if (!stringToHash(entry.hash, target)) {
+            status = SHADOW_INVALID;
+            break;
+        }
+        addTarget(targets, entry.name, entry.salt, target);
+    }
+    closeShadow(&shadow);
+    if (status == SHADOW_INVALID) {
+        fprintf(stderr, "Invalid shadow file entry\n");
+        exit(1);
+    }
+}
+
+/**
+ * Counts the candidates of a job whose source has an end.
+ * @param opts the options
+ * @param dictionary the dictionary, or the dictionary of first halves
+ * @param right the dictionary of second halves
+ * @param mask the mask
+ * @param rules the rules each word is expanded with
+ * @return the number of candidates, which is one past the cursor of the last one
+ */
+static long long jobKeyspace(Options const *opts, Dictionary const *dictionary,
+                             Dictionary const *right, Mask const *mask, RuleSet const *rules)
+{
+    long long expansions = rules->count > 0 ? rules->count : 1;
+    if (opts->source == SOURCE_MASK) {
+        return maskKeyspace(mask);
+    } else if (opts->source == SOURCE_COMBINATOR) {
+        return dictionary->count * right->count * expansions;
+    }
+    return dictionary->count * expansions;
+}
+
+/**
+ * Feeds a range of the candidates of a source that has an end.
+ * @param opts the options
+ * @param feeder the feeder
+ * @param dictionary the dictionary, or the dictionary of first halves
+ * @param right the second halves, filed by length
+ * @param mask the mask
+ * @param first cursor of the first candidate
+ * @param end cursor just past the last candidate
+ */
+static void feedRange(Options const *opts, Feeder *feeder, Dictionary const *dictionary,
+                      RightWords const *right, Mask const *mask, long long first,
+                      long long end)
+{
+    limitFeed(feeder, first, end);
+    if (opts->source == SOURCE_MASK) {
+        long long keyspace = maskKeyspace(mask);
+        feedMask(feeder, mask, first, (end < keyspace ? end : keyspace) - first);
+    } else if (opts->source == SOURCE_COMBINATOR) {
+        feedCombinator(feeder, dictionary, right);
     } else {
-        ungetc(ch, fp);
+        feedDictionary(feeder, dictionary);
     }
-    int len = 0;
-    char *word = (char*) malloc(16 * sizeof(char));
-    while ((ch = fgetc(fp)) != '\n' && ch != EOF) {
-        if (ch == ' ') {
-            fprintf(stderr, "Invalid dictionary word\n");
-            fclose(fp);
+}
+
+/**
+ * Hands the job out to workers, then prints every user they cracked, exiting if the
+ * address can't be listened on.
+ * @param opts the options
+ * @param job description of the job
+ * @param keyspace number of candidates in the job
+ * @param targets the users to crack
+ * @param pot the potfile, or NULL
+ */
+static void serveWorkers(Options const *opts, char const *job, long long keyspace,
+                         TargetSet const *targets, Potfile *pot)
+{
+    int listener = listenAddress(opts->serveAddress);
+    if (listener < 0) {
+        perror(opts->serveAddress);
+        exit(1);
+    }
+
+    // The workers hear about the potfile's passwords with their first lease.
+    Coordinator coord;
+    initCoordinator(&coord, targets, job, keyspace, opts->leaseTimeout, pot);
+    int known = 0;
+    for (int d = 0; pot != NULL && d < targets->digestCount; d++) {
+        Digest const *digest = &targets->digests[d];
+        char const *password = findPot(pot, targets->groups[digest->group].salt, digest->hash);
+        if (password != NULL) {
+            knownDigest(&coord, d, password);
+            known++;
+        }
+    }
+    serveJob(&coord, listener);
+    closeListener(listener, opts->serveAddress);
+    writeCoordinated(&coord, stdout);
+
+    if (opts->stats) {
+        fprintf(stderr, "%d workers took %lld leases, %lld of them expired ones taken again\n",
+                coord.workers, coord.leases.granted, coord.leases.reissued);
+        if (pot != NULL) {
+            fprintf(stderr, "%d of %d hashes found in the potfile\n", known,
+                    targets->digestCount);
+        }
+    }
+    freeCoordinator(&coord);
+}
+
+/**
+ * Works on leases from a coordinator until the job is done, exiting if the
+ * coordinator can't be reached, is running a different job, or goes away.
+ * @param opts the options
+ * @param job description of the job
+ * @param keyspace number of candidates in the job
+ * @param targets the users to crack
+ * @param engine the engine
+ * @param feeder the feeder
+ * @param dictionary the dictionary, or the dictionary of first halves
+ * @param right the second halves, filed by length
+ * @param mask the mask
+ */
+static void runWorker(Options const *opts, char const *job, long long keyspace,
+                      TargetSet const *targets, Engine *engine, Feeder *feeder,
+                      Dictionary const *dictionary, RightWords const *right, Mask const *mask)
+{
+    int fd = connectAddress(opts->workerAddress);
+    if (fd < 0) {
+        perror(opts->workerAddress);
+        exit(1);
+    }
+    Remote remote;
+    openRemote(&remote, fd, engine, targets);
+    int status = joinJob(&remote, keyspace, job);
+    if (status == REMOTE_REJECTED) {
+        fprintf(stderr, "Coordinator %s is running a different job\n", opts->workerAddress);
+        exit(1);
+    }
+
+    // Ask for a few seconds of work at a time, judging by how fast the last lease
+    // went, so a fast worker doesn't keep the coordinator busy and a slow one doesn't
+    // hold on to work the others could be doing.
+    long long size = (long long) FIRST_LEASE * opts->threads;
+    double target = remote.timeout / 4.0 < LEASE_TARGET_SECONDS ? remote.timeout / 4.0
+                                                                : LEASE_TARGET_SECONDS;
+    Lease lease;
+    while (status != REMOTE_LOST
+           && (status = requestLease(&remote, size, &lease)) != REMOTE_DONE
+           && status != REMOTE_LOST) {
+        if (status == REMOTE_WAIT) {
+            struct timespec wait = { 0, WAIT_NANOS };
+            nanosleep(&wait, NULL);
+            continue;
+        }
+
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        feedRange(opts, feeder, dictionary, right, mask, lease.start, lease.end);
+        int spins = 0;
+        while (!engineIdle(engine)) {
+            idleWait(&spins);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+
+        double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+        double next = seconds > 0 ? (lease.end - lease.start) * target / seconds
+                                  : size * 4.0;
+        size = next > size * 4.0 ? size * 4 : next < BATCH_WORDS ? BATCH_WORDS : (long long) next;
+        if (!returnLease(&remote, &lease)) {
+            status = REMOTE_LOST;
+        }
+    }
+    closeRemote(&remote);
+    if (status == REMOTE_LOST) {
+        fprintf(stderr, "Lost the coordinator at %s\n", opts->workerAddress);
+        exit(1);
+    }
+}
+
+/**
+ * Merges the output of every shard of a job and prints it as the whole job would
+ * have, exiting if an output file can't be read or doesn't match the shadow file.
+ * @param opts the options
+ */
+static void mergeShards(Options const *opts)
+{
+    TargetSet targets;
+    initTargetSet(&targets);
+    loadTargets(opts->shadowName, &targets);
+
+    ResultMerge merge;
+    initMerge(&merge, &targets);
+    for (int i = 1; i < opts->fileCount; i++) {
+        int line;
+        int status = mergeResults(&merge, opts->files[i], &line);
+        if (status == MERGE_UNREADABLE) {
+            perror(opts->files[i]);
+            exit(1);
+        } else if (status == MERGE_INVALID) {
+            fprintf(stderr, "Invalid result on line %d of %s\n", line, opts->files[i]);
             exit(1);
         }
-        word[len++] = ch;
     }
-    word[len] = '\0';
-    return word;
+    writeMerged(&merge, stdout);
+    freeMerge(&merge);
+    freeTargetSet(&targets);
 }
 
 int main(int argc, char *argv[])
 {
-    if (argc != 3) {
-        usage();
+    Options opts;
+    parseOptions(argc, argv, &opts);
+    if (opts.source == SOURCE_MERGE) {
+        mergeShards(&opts);
+        free(opts.files);
+        return 0;
+    }
+
+    if (!md5SelectKernel(opts.kernelName)) {
+        fprintf(stderr, "Unsupported md5 kernel: %s\n", opts.kernelName);
         exit(1);
     }
-    FILE *dictionary = fopen(argv[1], "r");
 
-    int capacity = 10; // initial capacity
-    char **dictionaryWords = malloc(capacity * sizeof(char*));
-    int count = 0;
-    char *word;
+    RuleSet rules;
+    RuleSet loopRules;
+    initRuleSet(&rules);
+    initRuleSet(&loopRules);
+    loadRuleFile(opts.rulesName, &rules);
+    loadRuleFile(opts.loopRulesName, &loopRules);
 
-    while ((word = readWord(dictionary)) != NULL) {
-        if (count >= capacity) {
-            if (count > 1000) {
-                fprintf(stderr, "Too many dictionary words\n");
-                exit(1);
-            }
-            capacity *= 2; // double the capacity
-            dictionaryWords = realloc(dictionaryWords,
-                    capacity * sizeof(char*));
-        }
-        dictionaryWords[count] = malloc(strlen(word) + 1);
-        strcpy(dictionaryWords[count], word);
-        count++;
-    }
-
-    fclose(dictionary);
-
-    FILE *shadow = fopen(argv[2], "r");
-
-    char *line;
-    char name[33];
-    char salt[9];
-    char hash[23];
-    char buffer[11];
-
-    int len;
-    
-    while ((line = readLine(shadow)) != NULL) {
-        int offset = 0;
-        if (sscanf(line, "%31[^: ]%n", name, &len) == 1) {
-            offset += len;
-        }
-        if (sscanf(line + offset, "%[:$1]%n", buffer, &len) == 1) {
-            offset += len;
-            if ((strlen(buffer) != 4)
-                    || (buffer[0] != ':' && buffer[1] != '$' && buffer[2] != '1'
-                            && buffer[3] != '$')) {
-                for (int i = 0; i < count; i++) {
-                    free(dictionaryWords[i]);
-                }
-                free(dictionaryWords);
-                //error is here somewhere, probably not scanning enough after the first user and hash is parsed, put breakpoint at 144
-                fprintf(stderr, "Invalid shadow file entry\n");
-                exit(1);
-            }
+    // A dictionary from standard input is read as it arrives instead.
+    Dictionary dictionary;
+    Dictionary right;
+    RightWords rightWords;
+    Mask mask;
+    if (opts.source == SOURCE_DICTIONARY || opts.source == SOURCE_COMBINATOR) {
+        loadDictionary(opts.dictionaryName, &dictionary, opts.threads);
+    }
+    if (opts.source == SOURCE_COMBINATOR) {
+        loadDictionary(opts.rightName, &right, opts.threads);
+        fileRightWords(&rightWords, &right);
+    } else if (opts.source == SOURCE_MASK && !parseMask(&mask, opts.maskText, opts.increment)) {
+        fprintf(stderr, "Invalid mask: %s\n", opts.maskText);
+        exit(1);
+    }
+
+    TargetSet targets;
+    initTargetSet(&targets);
+    loadTargets(opts.shadowName, &targets);
+
+    Potfile pot;
+    if (opts.potName != NULL && !openPotfile(&pot, opts.potName)) {
+        perror(opts.potName);
+        exit(1);
+    }
+
+    // Passwords cracked before the checkpoint are answered just like the potfile's.
+    char job[JOB_LIMIT + 1];
+    describeJob(&opts, job);
+    Potfile restored;
+    initPotfile(&restored);
+    long long skip = opts.restore ? restoreCheckpoint(&opts, job, &restored) : 0;
+
+    // A coordinator hands the hashing out rather than doing any itself.
+    if (opts.serveAddress != NULL) {
+        serveWorkers(&opts, job, jobKeyspace(&opts, &dictionary, &right, &mask, &rules),
+                     &targets, opts.potName != NULL ? &pot : NULL);
+        if (opts.source == SOURCE_DICTIONARY || opts.source == SOURCE_COMBINATOR) {
+            closeDictionary(&dictionary);
         }
-        if (sscanf(line + offset, "%[^$ ]%n", salt, &len) == 1) {
-            offset += len;
-            sscanf(line + offset, "%c%n", buffer, &len);
-            offset += len;
-            if (strlen(salt) != SALT_LENGTH) {
-                for (int i = 0; i < count; i++) {
-                    free(dictionaryWords[i]);
-                }
-                free(dictionaryWords);
-                fprintf(stderr, "Invalid shadow file entry\n");
-                exit(1);
-            }
+        if (opts.source == SOURCE_COMBINATOR) {
+            freeRightWords(&rightWords);
+            closeDictionary(&right);
         }
-        if (sscanf(line + offset, "%[^: ]%n", hash, &len) == 1) {
-            offset += len;
-            if (strlen(hash) != PW_HASH_LIMIT) {
-                for (int i = 0; i < count; i++) {
-                    free(dictionaryWords[i]);
-                }
-                free(dictionaryWords);
-                fprintf(stderr, "Invalid shadow file entry\n");
-                exit(1);
-            }
+        closePotfile(&restored);
+        if (opts.potName != NULL) {
+            closePotfile(&pot);
         }
+        freeRuleSet(&rules);
+        freeRuleSet(&loopRules);
+        freeTargetSet(&targets);
+        free(opts.files);
+        return 0;
+    }
 
-        char result[PW_HASH_LIMIT + 1];
+    // Start the workers, then feed them candidates in batches while they hash.
+    // Each candidate is hashed once per distinct salt, and the result looked up among
+    // all the hashes that use that salt.
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    // A worker's matches go back to the coordinator, which writes them all out.
+    Engine *engine = startEngine(&targets, opts.threads,
+                                 opts.workerAddress != NULL ? NULL : stdout,
+                                 opts.potName != NULL ? &pot : NULL);
 
-        for (int i = 0; i < count; i++) {
-            hashPassword(dictionaryWords[i], salt, result);
-            if (strcmp(result, hash) == 0) {
-                printf("%s : %s\n", name, dictionaryWords[i]);
-            }
+    // Hashes already in the potfile are answered before anything is hashed, so if
+    // they're all there, the engine is solved before it starts.
+    int known = 0;
+    for (int d = 0; d < targets.digestCount; d++) {
+        Digest const *digest = &targets.digests[d];
+        char const *salt = targets.groups[digest->group].salt;
+        char const *password = opts.potName != NULL ? findPot(&pot, salt, digest->hash) : NULL;
+        if (password == NULL) {
+            password = findPot(&restored, salt, digest->hash);
+        }
+        if (password != NULL) {
+            knownPassword(engine, d, password);
+            known++;
+        }
+    }
+
+    Dedup dedup;
+    initDedup(&dedup, opts.dedupMode, opts.bloomBytes);
+    Feeder feeder;
+    startFeed(&feeder, engine, &rules, &dedup);
+    if (opts.loopback) {
+        startLoopback(&feeder, &loopRules);
+    }
+    shardFeed(&feeder, opts.shard - 1, opts.shards);
+
+    // With checkpoints, the first SIGINT or SIGTERM stops the job cleanly instead.
+    Checkpoint checkpoint;
+    if (opts.checkpointName != NULL) {
+        initCheckpoint(&checkpoint, opts.checkpointName, job, &targets,
+                       opts.checkpointInterval);
+        struct sigaction action;
+        memset(&action, 0, sizeof(action));
+        action.sa_handler = requestStop;
+        action.sa_flags = SA_RESETHAND;
+        sigemptyset(&action.sa_mask);
+        sigaction(SIGINT, &action, NULL);
+        sigaction(SIGTERM, &action, NULL);
+        resumeFeed(&feeder, &checkpoint, skip, &stopRequested);
+    }
+    if (opts.workerAddress != NULL) {
+        runWorker(&opts, job, jobKeyspace(&opts, &dictionary, &right, &mask, &rules),
+                  &targets, engine, &feeder, &dictionary, &rightWords, &mask);
+    } else if (opts.source == SOURCE_STDIN) {
+        if (!feedStream(&feeder, STDIN_FILENO)) {
+            fprintf(stderr, "Invalid dictionary word\n");
+            exit(1);
+        }
+    } else {
+        feedRange(&opts, &feeder, &dictionary, &rightWords, &mask, skip, LLONG_MAX);
+    }
+    drainLoopback(&feeder);
+
+    // A stopped job saves where it got to; a finished one has no more use for its
+    // checkpoint.
+    bool stopped = stopRequested;
+    if (opts.checkpointName != NULL && stopped
+            && !finalCheckpoint(&checkpoint, engine, feeder.cursor)) {
+        perror(opts.checkpointName);
+    } else if (opts.checkpointName != NULL && !stopped) {
+        remove(opts.checkpointName);
+    }
+
+    CrackResult result;
+    finishEngine(engine, &result);
+    if (opts.source == SOURCE_DICTIONARY || opts.source == SOURCE_COMBINATOR) {
+        closeDictionary(&dictionary);
+    }
+    if (opts.source == SOURCE_COMBINATOR) {
+        freeRightWords(&rightWords);
+        closeDictionary(&right);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    if (opts.stats) {
+        double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+        fprintf(stderr, "%lld hashes in %.3f s (%.0f/s) on %d threads, %s kernel\n",
+                result.hashed, seconds, seconds > 0 ? result.hashed / seconds : 0.0,
+                opts.threads, md5KernelName());
+        // Each duplicate would have cost a chain for every salt, less any salts that
+        // were cracked before it came up.
+        if (dedup.mode != DEDUP_OFF) {
+            fprintf(stderr, "%lld duplicate candidates skipped, saving up to %lld hash chains\n",
+                    dedup.skipped, dedup.skipped * targets.groupCount);
+        }
+        if (opts.loopback) {
+            fprintf(stderr, "%lld candidates looped back\n", feeder.looped);
+        }
+        if (opts.potName != NULL) {
+            fprintf(stderr, "%d of %d hashes found in the potfile\n", known,
+                    targets.digestCount);
         }
     }
-    for (int i = 0; i < count; i++) {
-        free(dictionaryWords[i]);
+    freeDedup(&dedup);
+    closePotfile(&restored);
+    if (opts.potName != NULL) {
+        closePotfile(&pot);
     }
-    free(dictionaryWords);
-    fclose(shadow);
-}
\ No newline at end of file
+    freeRuleSet(&rules);
+    freeRuleSet(&loopRules);
+    freeTargetSet(&targets);
+    free(opts.files);
+    if (stopped) {
+        fprintf(stderr, "Stopped; run again with %s to pick up where this left off\n",
+                RESTORE_OPTION);
+        exit(1);
+    }
+}
@@ -0,0 +1,204 @@
+/**
+ * @file dedup.c
+ * @author Sean Leana (smleana)
+ * This file filters out duplicate candidates. The exact filter keeps a copy of every
+ * candidate in one arena, with an open-addressing table of offsets into it. The Bloom
+ * filter sets a few bits for each candidate, all of them in one cache-line block
+ * picked by the candidate's hash, so checking a candidate touches one line of memory
+ * no matter how big the filter is.
+ */
+
+#include "dedup.h"
+#include <stdlib.h>
+#include <string.h>
+
+/** Initial number of slots in the exact filter's table. */
+#define INITIAL_SLOTS 1024
+
+/** Initial size of the exact filter's arena. */
+#define INITIAL_ARENA 65536
+
+/** Number of bits set in a Bloom filter block for each candidate. */
+#define BLOOM_PROBES 7
+
+/** Number of 64-bit words in a Bloom filter block. */
+#define BLOCK_WORDS (BLOOM_BLOCK_BYTES / sizeof(unsigned long long))
+
+/**
+ * Hashes a candidate (64-bit FNV-1a, with a final mix so the high and low bits are
+ * both usable).
+ * @param word the candidate
+ * @param len its length
+ * @return the hash
+ */
+static unsigned long long wordHash(char const *word, int len)
+{
+    unsigned long long h = 14695981039346656037ULL;
+    for (int i = 0; i < len; i++) {
+        h = (h ^ (unsigned char) word[i]) * 1099511628211ULL;
+    }
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return h;
+}
+
+/**
+ * Puts an entry into the exact filter's table, without checking whether it has room.
+ * @param dedup the filter
+ * @param hash hash of the candidate
+ * @param entry the slot's entry for the candidate
+ */
+static void insertSlot(Dedup *dedup, unsigned long long hash, size_t entry)
+{
+    size_t mask = dedup->capacity - 1;
+    size_t i = hash & mask;
+    while (dedup->slots[i].entry != 0) {
+        i = (i + 1) & mask;
+    }
+    dedup->slots[i].hash = hash;
+    dedup->slots[i].entry = entry;
+}
+
+/**
+ * Doubles the size of the exact filter's table.
+ * @param dedup the filter
+ */
+static void growSlots(Dedup *dedup)
+{
+    DedupSlot *old = dedup->slots;
+    size_t oldCapacity = dedup->capacity;
+    dedup->capacity *= 2;
+    dedup->slots = (DedupSlot *) calloc(dedup->capacity, sizeof(DedupSlot));
+    for (size_t i = 0; i < oldCapacity; i++) {
+        if (old[i].entry != 0) {
+            insertSlot(dedup, old[i].hash, old[i].entry);
+        }
+    }
+    free(old);
+}
+
+/**
+ * Checks a candidate against the exact filter, adding it if it's new.
+ * @param dedup the filter
+ * @param word the candidate
+ * @param len its length
+ * @return true if the candidate is new
+ */
+static bool exactSighting(Dedup *dedup, char const *word, int len)
+{
+    unsigned long long hash = wordHash(word, len);
+    size_t mask = dedup->capacity - 1;
+    for (size_t i = hash & mask; dedup->slots[i].entry != 0; i = (i + 1) & mask) {
+        char const *seen = dedup->arena + dedup->slots[i].entry - 1;
+        if (dedup->slots[i].hash == hash && memcmp(seen, word, len) == 0
+                && seen[len] == '\0') {
+            return false;
+        }
+    }
+
+    // Keep the table at most half full.
+    if ((dedup->count + 1) * 2 > dedup->capacity) {
+        growSlots(dedup);
+    }
+    if (dedup->arenaSize + len + 1 > dedup->arenaCapacity) {
+        while (dedup->arenaSize + len + 1 > dedup->arenaCapacity) {
+            dedup->arenaCapacity *= 2;
+        }
+        dedup->arena = (char *) realloc(dedup->arena, dedup->arenaCapacity);
+    }
+    memcpy(dedup->arena + dedup->arenaSize, word, len);
+    dedup->arena[dedup->arenaSize + len] = '\0';
+    insertSlot(dedup, hash, dedup->arenaSize + 1);
+    dedup->arenaSize += len + 1;
+    dedup->count++;
+    return true;
+}
+
+/**
+ * Checks a candidate against the Bloom filter, setting its bits. The high bits of
+ * the hash pick the block, and each probe takes 9 bits of a second mix of the hash
+ * to pick one of the block's 512 bits.
+ * @param dedup the filter
+ * @param word the candidate
+ * @param len its length
+ * @return true if any of the candidate's bits wasn't set yet
+ */
+static bool bloomSighting(Dedup *dedup, char const *word, int len)
+{
+    unsigned long long hash = wordHash(word, len);
+    unsigned long long *block = dedup->bits + (hash >> 32 & (dedup->blocks - 1)) * BLOCK_WORDS;
+    unsigned long long probes = hash * 0x9e3779b97f4a7c15ULL;
+    bool fresh = false;
+    for (int p = 0; p < BLOOM_PROBES; p++) {
+        int bit = probes >> (p * 9) & (BLOOM_BLOCK_BYTES * 8 - 1);
+        unsigned long long m = 1ULL << (bit % 64);
+        if ((block[bit / 64] & m) == 0) {
+            block[bit / 64] |= m;
+            fresh = true;
+        }
+    }
+    return fresh;
+}
+
+/**
+ * Initializes a filter.
+ * @param dedup the filter to initialize
+ * @param mode DEDUP_OFF, DEDUP_EXACT or DEDUP_BLOOM
+ * @param bloomBytes largest amount of memory for a Bloom filter's bits
+ */
+void initDedup(Dedup *dedup, int mode, size_t bloomBytes)
+{
+    memset(dedup, 0, sizeof(Dedup));
+    dedup->mode = mode;
+    if (mode == DEDUP_EXACT) {
+        dedup->capacity = INITIAL_SLOTS;
+        dedup->slots = (DedupSlot *) calloc(dedup->capacity, sizeof(DedupSlot));
+        dedup->arenaCapacity = INITIAL_ARENA;
+        dedup->arena = (char *) malloc(dedup->arenaCapacity);
+    } else if (mode == DEDUP_BLOOM) {
+        dedup->blocks = 1;
+        while (dedup->blocks * 2 * BLOOM_BLOCK_BYTES <= bloomBytes) {
+            dedup->blocks *= 2;
+        }
+        dedup->bits = (unsigned long long *) calloc(dedup->blocks * BLOCK_WORDS,
+                                                    sizeof(unsigned long long));
+    }
+}
+
+/**
+ * Checks whether a candidate is new, and remembers it.
+ * @param dedup the filter
+ * @param word the candidate, which doesn't need to be null terminated
+ * @param len its length
+ * @return true if the candidate should be hashed
+ */
+bool firstSighting(Dedup *dedup, char const *word, int len)
+{
+    bool fresh = true;
+    if (dedup->mode == DEDUP_EXACT) {
+        fresh = exactSighting(dedup, word, len);
+    } else if (dedup->mode == DEDUP_BLOOM) {
+        fresh = bloomSighting(dedup, word, len);
+    }
+    if (fresh) {
+        dedup->passed++;
+    } else {
+        dedup->skipped++;
+    }
+    return fresh;
+}
+
+/**
+ * Frees a filter's memory.
+ * @param dedup the filter
+ */
+void freeDedup(Dedup *dedup)
+{
+    free(dedup->slots);
+    free(dedup->arena);
+    free(dedup->bits);
+    dedup->slots = NULL;
+    dedup->arena = NULL;
+    dedup->bits = NULL;
+}
@@ -0,0 +1,77 @@
+/**
+ * @file dedup.h
+ * @author Sean Leana (smleana)
+ * This file defines the filter that keeps duplicate candidates away from the hasher.
+ * Every candidate costs a whole md5-crypt chain for each salt, so it's much cheaper
+ * to remember what has been tried than to try it again. The exact filter remembers
+ * every candidate; the Bloom filter uses a fixed amount of memory, and may now and
+ * then take a new candidate for one it has already seen.
+ */
+
+#ifndef _DEDUP_H_
+#define _DEDUP_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/** Mode of a filter that lets every candidate through. */
+#define DEDUP_OFF 0
+
+/** Mode of a filter that remembers every candidate exactly. */
+#define DEDUP_EXACT 1
+
+/** Mode of a filter that remembers candidates in a blocked Bloom filter. */
+#define DEDUP_BLOOM 2
+
+/** Size of a Bloom filter block, one cache line. */
+#define BLOOM_BLOCK_BYTES 64
+
+/** Default size of a Bloom filter. */
+#define DEDUP_BLOOM_BYTES 33554432
+
+/** One slot of the exact filter's open-addressing table. */
+typedef struct {
+    /** Hash of the candidate in this slot. */
+    unsigned long long hash;
+
+    /** One more than the candidate's offset in the arena, or 0 for an empty slot. */
+    size_t entry;
+} DedupSlot;
+
+/** A filter of the candidates seen so far. */
+typedef struct {
+    /** DEDUP_OFF, DEDUP_EXACT or DEDUP_BLOOM. */
+    int mode;
+
+    /** For DEDUP_EXACT, the table of candidates seen, and how many are in it. */
+    DedupSlot *slots;
+    size_t capacity;
+    size_t count;
+
+    /** For DEDUP_EXACT, every candidate seen, each followed by a null. */
+    char *arena;
+    size_t arenaSize;
+    size_t arenaCapacity;
+
+    /** For DEDUP_BLOOM, the filter's bits and the number of blocks they make up,
+        always a power of two. */
+    unsigned long long *bits;
+    size_t blocks;
+
+    /** Number of candidates let through, and number turned away as duplicates. */
+    long long passed;
+    long long skipped;
+} Dedup;
+
+/** initializes a filter with the given mode. A Bloom filter uses about bloomBytes of
+ * memory, rounded down to a power of two number of blocks. */
+void initDedup( Dedup *dedup, int mode, size_t bloomBytes );
+
+/** returns true if the word of len characters hasn't been seen before, and remembers
+ * it. A Bloom filter may rarely return false for a word it hasn't seen. */
+bool firstSighting( Dedup *dedup, char const *word, int len );
+
+/** frees the memory used by a filter */
+void freeDedup( Dedup *dedup );
+
+#endif
@@ -0,0 +1,107 @@
+/**
+ * @file deque.c
+ * @author Sean Leana (smleana)
+ * This file implements a fixed-capacity Chase-Lev work-stealing deque using the GCC
+ * __atomic builtins. The owner works at the bottom and only synchronizes with thieves
+ * when it takes the last task; thieves race each other for the top with a CAS.
+ */
+
+#include "deque.h"
+#include <stdlib.h>
+
+/**
+ * Initializes an empty deque.
+ * @param deque the deque to initialize
+ * @param capacity smallest number of tasks it should hold
+ */
+void initDeque(TaskDeque *deque, long long capacity)
+{
+    deque->capacity = 1;
+    while (deque->capacity < capacity) {
+        deque->capacity *= 2;
+    }
+    deque->items = (Task *) malloc(deque->capacity * sizeof(Task));
+    deque->top = 0;
+    deque->bottom = 0;
+}
+
+/**
+ * Frees the memory used by a deque.
+ * @param deque the deque
+ */
+void freeDeque(TaskDeque *deque)
+{
+    free(deque->items);
+    deque->items = NULL;
+}
+
+/**
+ * Pushes a task onto the bottom of the deque. Only the deque's owner may call this.
+ * @param deque the deque
+ * @param task the task to push
+ * @return false if the deque is full
+ */
+bool pushTask(TaskDeque *deque, Task task)
+{
+    long long b = __atomic_load_n(&deque->bottom, __ATOMIC_RELAXED);
+    long long t = __atomic_load_n(&deque->top, __ATOMIC_ACQUIRE);
+    if (b - t >= deque->capacity) {
+        return false;
+    }
+    __atomic_store_n(&deque->items[b & (deque->capacity - 1)], task, __ATOMIC_RELAXED);
+    __atomic_store_n(&deque->bottom, b + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+/**
+ * Pops the newest task from the bottom of the deque. Only the deque's owner may call
+ * this.
+ * @param deque the deque
+ * @return the task, or NO_TASK if the deque is empty
+ */
+Task popTask(TaskDeque *deque)
+{
+    long long b = __atomic_load_n(&deque->bottom, __ATOMIC_RELAXED) - 1;
+    __atomic_store_n(&deque->bottom, b, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    long long t = __atomic_load_n(&deque->top, __ATOMIC_RELAXED);
+
+    if (t > b) {
+        // Already empty; put bottom back.
+        __atomic_store_n(&deque->bottom, b + 1, __ATOMIC_RELAXED);
+        return NO_TASK;
+    }
+
+    Task task = __atomic_load_n(&deque->items[b & (deque->capacity - 1)], __ATOMIC_RELAXED);
+    if (t == b) {
+        // This is the last task, so we have to race any thieves for it.
+        if (!__atomic_compare_exchange_n(&deque->top, &t, t + 1, false,
+                                         __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+            task = NO_TASK;
+        }
+        __atomic_store_n(&deque->bottom, b + 1, __ATOMIC_RELAXED);
+    }
+    return task;
+}
+
+/**
+ * Steals the oldest task from the top of the deque. Any thread may call this.
+ * @param deque the deque
+ * @return the task, or NO_TASK if the deque is empty or the task was taken first
+ */
+Task stealTask(TaskDeque *deque)
+{
+    long long t = __atomic_load_n(&deque->top, __ATOMIC_ACQUIRE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    long long b = __atomic_load_n(&deque->bottom, __ATOMIC_ACQUIRE);
+    if (t >= b) {
+        return NO_TASK;
+    }
+
+    Task task = __atomic_load_n(&deque->items[t & (deque->capacity - 1)], __ATOMIC_RELAXED);
+    if (!__atomic_compare_exchange_n(&deque->top, &t, t + 1, false,
+                                     __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+        return NO_TASK;
+    }
+    return task;
+}
@@ -0,0 +1,52 @@
+/**
+ * @file deque.h
+ * @author Sean Leana (smleana)
+ * This file defines a work-stealing deque of tasks. The worker that owns a deque pushes
+ * and pops tasks at the bottom without locking, and idle workers steal from the top.
+ */
+
+#ifndef _DEQUE_H_
+#define _DEQUE_H_
+
+#include <stdbool.h>
+
+/** A task, packed into one 64-bit value so it can be read and written atomically. */
+typedef long long Task;
+
+/** Result of pop or steal when there was no task to take. */
+#define NO_TASK -1LL
+
+/** A fixed-capacity Chase-Lev deque. */
+typedef struct {
+    /** Index of the oldest task, where thieves take from. */
+    long long top;
+
+    /** Index one past the newest task, where the owner pushes and pops. */
+    long long bottom;
+
+    /** Circular array of tasks. */
+    Task *items;
+
+    /** Number of slots in items, a power of two. */
+    long long capacity;
+} TaskDeque;
+
+/** initializes an empty deque with room for at least capacity tasks */
+void initDeque( TaskDeque *deque, long long capacity );
+
+/** frees the memory used by a deque */
+void freeDeque( TaskDeque *deque );
+
+/** pushes a task on the bottom of the deque; only the owner may call this. Returns
+ * false if the deque is full. */
+bool pushTask( TaskDeque *deque, Task task );
+
+/** pops the newest task from the bottom of the deque; only the owner may call this.
+ * Returns NO_TASK if the deque is empty. */
+Task popTask( TaskDeque *deque );
+
+/** steals the oldest task from the top of the deque; any thread may call this.
+ * Returns NO_TASK if the deque is empty or another thread got the task first. */
+Task stealTask( TaskDeque *deque );
+
+#endif
@@ -0,0 +1,326 @@
+/**
+ * @file dictionary.c
+ * @author Sean Leana (smleana)
+ * This file loads the dictionary by mapping the file and packing its words into one
+ * arena. The file is cut into segments of about a megabyte at line boundaries, and
+ * the segments are shared among threads. Each thread counts the words of each length
+ * in its segments, then, once every segment knows where its words go, copies them in,
+ * grouped by length. Words of one length are stored back to back with a fixed stride,
+ * so the only index is a table of counts per segment, and the arena is one allocation
+ * for the whole dictionary.
+ *
+ * Grouping by length within segments rather than across the whole file keeps the
+ * words close to the order of the file, so the most likely passwords at the top of a
+ * wordlist are still tried first.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "dictionary.h"
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/** Approximate size of a segment of the file. */
+#define SEGMENT_BYTES 1048576
+
+/** One thread's share of the packing work. */
+typedef struct {
+    /** The dictionary being packed. */
+    Dictionary *dict;
+
+    /** Where each segment starts and ends in the file. */
+    size_t const *bounds;
+
+    /** This thread handles segments id, id + threads, id + 2 * threads and so on. */
+    int id;
+    int threads;
+
+    /** Set if a word in this thread's segments is invalid. */
+    bool invalid;
+
+    /** The thread doing this share. */
+    pthread_t thread;
+} Share;
+
+/**
+ * Counts the words of each length in this share's segments, and checks that none of
+ * them contains a space or is too long.
+ * @param arg the share
+ * @return NULL
+ */
+static void *countWords(void *arg)
+{
+    Share *sh = (Share *) arg;
+    Dictionary *dict = sh->dict;
+    for (int s = sh->id; s < dict->segmentCount && !sh->invalid; s += sh->threads) {
+        char const *p = dict->data + sh->bounds[s];
+        char const *end = dict->data + sh->bounds[s + 1];
+        if (memchr(p, ' ', end - p) != NULL) {
+            sh->invalid = true;
+            break;
+        }
+        int *count = dict->segments[s].count;
+        while (p < end) {
+            char const *nl = memchr(p, '\n', end - p);
+            long len = (nl ? nl : end) - p;
+            if (len > PW_LIMIT) {
+                sh->invalid = true;
+                break;
+            }
+            count[len]++;
+            p = nl ? nl + 1 : end;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Copies the words in this share's segments into the arena, each after the words of
+ * the same length that came before it in its segment.
+ * @param arg the share
+ * @return NULL
+ */
+static void *copyWords(void *arg)
+{
+    Share *sh = (Share *) arg;
+    Dictionary *dict = sh->dict;
+    for (int s = sh->id; s < dict->segmentCount; s += sh->threads) {
+        Segment const *seg = &dict->segments[s];
+        char *next[PW_LIMIT + 1];
+        char *dest = dict->arena + seg->firstByte;
+        for (int len = 0; len <= PW_LIMIT; len++) {
+            next[len] = dest;
+            dest += (size_t) seg->count[len] * (len + 1);
+        }
+
+        char const *p = dict->data + sh->bounds[s];
+        char const *end = dict->data + sh->bounds[s + 1];
+        while (p < end) {
+            char const *nl = memchr(p, '\n', end - p);
+            int len = (nl ? nl : end) - p;
+            memcpy(next[len], p, len);
+            next[len][len] = '\0';
+            next[len] += len + 1;
+            p = nl ? nl + 1 : end;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Runs one pass over every share, each on its own thread except the first, which
+ * runs on the calling thread.
+ * @param shares the shares
+ * @param n number of shares
+ * @param pass function to run on each share
+ */
+static void runPass(Share *shares, int n, void *(*pass)(void *))
+{
+    for (int i = 1; i < n; i++) {
+        pthread_create(&shares[i].thread, NULL, pass, &shares[i]);
+    }
+    pass(&shares[0]);
+    for (int i = 1; i < n; i++) {
+        pthread_join(shares[i].thread, NULL);
+    }
+}
+
+/**
+ * Unmaps the dictionary file, if it's mapped.
+ * @param dict the dictionary
+ */
+static void unmapDictionary(Dictionary *dict)
+{
+    if (dict->data != NULL) {
+        munmap((void *) dict->data, dict->size);
+        dict->data = NULL;
+    }
+}
+
+/**
+ * Maps a dictionary file into memory.
+ * @param dict the dictionary to fill in
+ * @param filename name of the file
+ * @return false if the file couldn't be opened or mapped, with errno set
+ */
+bool openDictionary(Dictionary *dict, char const *filename)
+{
+    memset(dict, 0, sizeof(Dictionary));
+
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return false;
+    }
+    dict->size = st.st_size;
+
+    // An empty file can't be mapped, but there's nothing to map anyway.
+    if (dict->size > 0) {
+        void *data = mmap(NULL, dict->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            close(fd);
+            return false;
+        }
+        posix_madvise(data, dict->size, POSIX_MADV_SEQUENTIAL);
+        dict->data = (char const *) data;
+    }
+    close(fd);
+    return true;
+}
+
+/**
+ * Packs the words of a mapped dictionary into its arena, then unmaps the file.
+ * @param dict the dictionary
+ * @param threads largest number of threads to use
+ * @return false if a word contains a space or is longer than PW_LIMIT
+ */
+bool indexDictionary(Dictionary *dict, int threads)
+{
+    // Cut the file into segments that each end just after a newline, or at the end.
+    int capacity = dict->size / SEGMENT_BYTES + 2;
+    size_t *bounds = (size_t *) malloc((capacity + 1) * sizeof(size_t));
+    bounds[0] = 0;
+    dict->segmentCount = 0;
+    while (bounds[dict->segmentCount] < dict->size) {
+        size_t end = bounds[dict->segmentCount] + SEGMENT_BYTES;
+        if (end >= dict->size) {
+            end = dict->size;
+        } else {
+            char const *nl = memchr(dict->data + end - 1, '\n', dict->size - end + 1);
+            end = nl ? (size_t) (nl + 1 - dict->data) : dict->size;
+        }
+        bounds[++dict->segmentCount] = end;
+    }
+    dict->segments = (Segment *) calloc(dict->segmentCount + 1, sizeof(Segment));
+
+    int n = threads > 0 ? threads : 1;
+    if (n > dict->segmentCount) {
+        n = dict->segmentCount > 0 ? dict->segmentCount : 1;
+    }
+    Share *shares = (Share *) calloc(n, sizeof(Share));
+    for (int i = 0; i < n; i++) {
+        shares[i].dict = dict;
+        shares[i].bounds = bounds;
+        shares[i].id = i;
+        shares[i].threads = n;
+    }
+
+    runPass(shares, n, countWords);
+    bool invalid = false;
+    for (int i = 0; i < n; i++) {
+        invalid = invalid || shares[i].invalid;
+    }
+
+    if (!invalid) {
+        // Lay the segments out one after another.
+        long long words = 0;
+        size_t bytes = 0;
+        for (int s = 0; s < dict->segmentCount; s++) {
+            dict->segments[s].firstWord = words;
+            dict->segments[s].firstByte = bytes;
+            for (int len = 0; len <= PW_LIMIT; len++) {
+                words += dict->segments[s].count[len];
+                bytes += (size_t) dict->segments[s].count[len] * (len + 1);
+            }
+        }
+        dict->count = words;
+        dict->arena = (char *) malloc(bytes + 1);
+        runPass(shares, n, copyWords);
+    }
+
+    free(shares);
+    free(bounds);
+    unmapDictionary(dict);
+    return !invalid;
+}
+
+/**
+ * Returns one word.
+ * @param dict the dictionary
+ * @param i index of the word
+ * @param len where the length of the word is stored
+ * @return the word, in the arena
+ */
+char const *dictionaryWord(Dictionary const *dict, long long i, int *len)
+{
+    char const *word;
+    dictionaryWords(dict, i, 1, &word, len);
+    return word;
+}
+
+/**
+ * Finds a run of consecutive words. The words of each length are a fixed distance
+ * apart, so this only has to find the right segment and length once.
+ * @param dict the dictionary
+ * @param first index of the first word
+ * @param n largest number of words to find
+ * @param words where pointers to the words are stored
+ * @param lens where the lengths of the words are stored, unless it's NULL
+ * @return the number of words found, less than n only at the end of the dictionary
+ */
+int dictionaryWords(Dictionary const *dict, long long first, int n, char const *words[],
+                    int lens[])
+{
+    if (first >= dict->count) {
+        return 0;
+    }
+
+    // Binary search for the last segment that starts at or before the first word.
+    int lo = 0;
+    int hi = dict->segmentCount - 1;
+    while (lo < hi) {
+        int mid = (lo + hi + 1) / 2;
+        if (dict->segments[mid].firstWord <= first) {
+            lo = mid;
+        } else {
+            hi = mid - 1;
+        }
+    }
+
+    int found = 0;
+    long long skip = first - dict->segments[lo].firstWord;
+    for (int s = lo; s < dict->segmentCount && found < n; s++) {
+        Segment const *seg = &dict->segments[s];
+        char const *p = dict->arena + seg->firstByte;
+        for (int len = 0; len <= PW_LIMIT && found < n; len++) {
+            if (skip >= seg->count[len]) {
+                skip -= seg->count[len];
+                p += (size_t) seg->count[len] * (len + 1);
+                continue;
+            }
+            p += skip * (len + 1);
+            for (long long k = skip; k < seg->count[len] && found < n; k++) {
+                if (lens != NULL) {
+                    lens[found] = len;
+                }
+                words[found++] = p;
+                p += len + 1;
+            }
+            skip = 0;
+        }
+    }
+    return found;
+}
+
+/**
+ * Frees the arena of a dictionary, and unmaps it if that hasn't happened yet.
+ * @param dict the dictionary
+ */
+void closeDictionary(Dictionary *dict)
+{
+    unmapDictionary(dict);
+    free(dict->arena);
+    free(dict->segments);
+    dict->arena = NULL;
+    dict->segments = NULL;
+    dict->count = 0;
+}
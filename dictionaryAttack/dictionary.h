@@ -0,0 +1,64 @@
+/**
+ * @file dictionary.h
+ * @author Sean Leana (smleana)
+ * This file defines the dictionary of candidate words. The dictionary file is mapped
+ * into memory and its words are packed into one arena, grouped by length, so they can
+ * be handed out as pointers without being copied or allocated one at a time.
+ */
+
+#ifndef _DICTIONARY_H_
+#define _DICTIONARY_H_
+
+#include "password.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+/** The words from one stretch of the dictionary file. Within a segment the words are
+    grouped by length, and each length keeps the order of the file. */
+typedef struct {
+    /** Index of the segment's first word, and where its words start in the arena. */
+    long long firstWord;
+    size_t firstByte;
+
+    /** Number of words of each length. */
+    int count[ PW_LIMIT + 1 ];
+} Segment;
+
+/** A dictionary file, packed into an arena of null-terminated words. */
+typedef struct {
+    /** Contents of the file, while it's mapped. */
+    char const *data;
+    size_t size;
+
+    /** Every word, each followed by a null. */
+    char *arena;
+
+    /** The segments, in the order of the file. */
+    Segment *segments;
+    int segmentCount;
+
+    /** Number of words. */
+    long long count;
+} Dictionary;
+
+/** maps the given file into memory, without packing it yet. Returns false, with
+ * errno set, if the file can't be opened or mapped. */
+bool openDictionary( Dictionary *dict, char const *filename );
+
+/** packs the words of the mapped file into the arena, splitting the work among the
+ * given number of threads, and unmaps the file. Returns false if any word contains
+ * a space or is too long. */
+bool indexDictionary( Dictionary *dict, int threads );
+
+/** returns word i, null terminated, and stores its length */
+char const *dictionaryWord( Dictionary const *dict, long long i, int *len );
+
+/** stores pointers to up to n words, starting with word first, in words, and their
+ * lengths in lens unless it's NULL, and returns how many there were */
+int dictionaryWords( Dictionary const *dict, long long first, int n, char const *words[],
+                     int lens[] );
+
+/** unmaps the file if it's still mapped and frees the arena */
+void closeDictionary( Dictionary *dict );
+
+#endif
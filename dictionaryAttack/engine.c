@@ -0,0 +1,628 @@
+/**
+ * @file engine.c
+ * @author Sean Leana (smleana)
+ * This file runs the cracking work as a pipeline. The reader fills batches of candidate
+ * words in a ring and publishes them; worker threads claim batches from the ring and
+ * split each one into tasks, one per salt group. Every worker has its own
+ * work-stealing deque of tasks and its own scratch space and match list, so a thread
+ * that gets a slow task doesn't leave the rest of the cores idle. The ring is
+ * single-producer, multi-consumer and lock-free: the reader and workers only ever
+ * wait by yielding, never on a mutex. Matches go straight to the result writer, which
+ * is told as each salt group finishes so it can write users out in order.
+ *
+ * Cracked hashes drop out as soon as they're found. A salt group whose hashes are all
+ * cracked is retired, so its tasks are skipped, and once every hash is cracked the
+ * engine is solved and the reader can stop.
+ *
+ * Every cracked password is also kept, in the order it was found, for the reader to
+ * loop back as new candidates. Those go into a second, smaller ring that workers
+ * always claim from first, so they jump ahead of everything already queued.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "engine.h"
+#include "deque.h"
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+
+/** Number of batches in the ring between the reader and the workers. */
+#define RING_BATCHES 256
+
+/** Number of batches in the loopback ring, which follows the main one in memory. */
+#define LOOP_BATCHES 16
+
+/** Number of times an idle worker goes around all the other deques looking for
+    something to steal before it looks for new batches again. */
+#define STEAL_ROUNDS 4
+
+/** Number of times an idle thread yields before it starts sleeping. */
+#define SPIN_LIMIT 64
+
+/** How long an idle thread sleeps, in nanoseconds, once it's done spinning. */
+#define IDLE_NANOS 100000
+
+/** State for one worker thread. */
+typedef struct {
+    /** The engine this worker belongs to. */
+    Engine *engine;
+
+    /** Index of this worker. */
+    int id;
+
+    /** Tasks waiting to be run by this worker, or stolen by others. */
+    TaskDeque deque;
+
+    /** Number of matches this worker has found. */
+    long long matched;
+
+    /** Number of candidate hashes this worker has computed. */
+    long long hashed;
+
+    /** State for picking which worker to steal from. */
+    unsigned int seed;
+
+    /** The thread running this worker. */
+    pthread_t thread;
+} Worker;
+
+/** State shared by the reader and the workers. */
+struct EngineStruct {
+    /** The users being cracked. */
+    TargetSet const *targets;
+
+    /** Ring of batches between the reader and the workers, followed by the
+        loopback ring. */
+    WordBatch *ring;
+
+    /** Number of batches the reader has published. Only the reader writes this. */
+    long long published;
+
+    /** Number of batches the workers have claimed. Workers claim with a CAS. */
+    long long claimed;
+
+    /** The same counts for the loopback ring. */
+    long long loopPublished;
+    long long loopClaimed;
+
+    /** Position of the next word the reader will publish. */
+    long long nextFirst;
+
+    /** Number of main ring batches known to be finished, all of them before any that
+        aren't, and the cursor of the last one. Only the reader uses these. */
+    long long doneBatches;
+    long long doneCursor;
+
+    /** Set once the reader has published its last batch. */
+    int finished;
+
+    /** For each salt group, the number of batches hashed with its salt so far. */
+    long long *groupBatches;
+
+    /** For each digest, set once a worker has cracked it. */
+    int *cracked;
+
+    /** For each salt group, the number of its digests that aren't cracked yet. A
+        group is retired once this reaches zero. */
+    int *groupLeft;
+
+    /** Number of digests that aren't cracked yet; the engine is solved at zero. */
+    int digestsLeft;
+
+    /** Cracked passwords, in the order they were found. A worker reserves a place
+        by bumping crackedCount, and sets the place's ready flag once the password
+        is stored. There can't be more than one per digest. */
+    char (*crackedWords)[PW_LIMIT + 1];
+    int *crackedDigests;
+    int *crackedReady;
+    int crackedCount;
+
+    /** Number of cracked passwords the reader has taken. Only the reader uses this. */
+    int crackedTaken;
+
+    /** Number of users whose passwords were known before any hashing. */
+    long long knownCount;
+
+    /** Writes out the matches in order as the workers find them. */
+    ResultWriter *writer;
+
+    /** All the workers. */
+    Worker *workers;
+    int workerCount;
+};
+
+/**
+ * Packs a slot in the ring and a salt group into a task. A slot isn't reused until
+ * every task for its batch is done, so the slot is enough to find the batch.
+ * @param slot index of the batch in the ring
+ * @param group index of the salt group
+ * @return the task
+ */
+static Task makeTask(int slot, int group)
+{
+    return ((Task) slot << 32) | (Task) group;
+}
+
+/**
+ * Returns the number of batches published so far, in both rings.
+ * @param engine the engine
+ * @return the number of batches
+ */
+static long long totalPublished(Engine *engine)
+{
+    return __atomic_load_n(&engine->published, __ATOMIC_SEQ_CST)
+        + __atomic_load_n(&engine->loopPublished, __ATOMIC_SEQ_CST);
+}
+
+/**
+ * Reports every user with a newly cracked digest to the writer, keeps the password
+ * for loopback, and drops the digest from the ones still left to crack, retiring its
+ * group if it was the last one. Only the thread that marked the digest cracked may
+ * call this.
+ * @param engine the engine
+ * @param producer index of the calling thread's queue in the writer
+ * @param d index of the digest
+ * @param word position of the word that cracked it in the stream of candidates
+ * @param password the word that cracked it
+ * @return the number of users reported
+ */
+static int crackDigest(Engine *engine, int producer, int d, long long word,
+                       char const *password)
+{
+    TargetSet const *targets = engine->targets;
+    int matched = 0;
+    for (int u = targets->digests[d].firstUser; u >= 0; u = targets->users[u].next) {
+        submitMatch(engine->writer, producer, u, word, password);
+        finishUser(engine->writer, u);
+        matched++;
+    }
+    int k = __atomic_fetch_add(&engine->crackedCount, 1, __ATOMIC_RELAXED);
+    strcpy(engine->crackedWords[k], password);
+    engine->crackedDigests[k] = d;
+    __atomic_store_n(&engine->crackedReady[k], 1, __ATOMIC_RELEASE);
+
+    __atomic_sub_fetch(&engine->groupLeft[targets->digests[d].group], 1, __ATOMIC_RELEASE);
+    __atomic_sub_fetch(&engine->digestsLeft, 1, __ATOMIC_RELEASE);
+    return matched;
+}
+
+/**
+ * Hashes one task's batch of words with its salt, and reports every user whose hash
+ * comes out, unless the group has retired in the meantime. When the last task for a
+ * batch finishes, the batch goes back to the reader.
+ * @param w the worker running the task
+ * @param task the task
+ */
+static void runTask(Worker *w, Task task)
+{
+    TargetSet const *targets = w->engine->targets;
+    WordBatch *batch = &w->engine->ring[task >> 32];
+    int group = (int) (task & 0xFFFFFFFF);
+    int n = batch->count;
+
+    Engine *engine = w->engine;
+
+    // A group can retire after its tasks for a batch were pushed.
+    if (__atomic_load_n(&engine->groupLeft[group], __ATOMIC_RELAXED) > 0) {
+        char const *salts[BATCH_WORDS];
+        byte hash[BATCH_WORDS][HASH_SIZE];
+        for (int i = 0; i < n; i++) {
+            salts[i] = targets->groups[group].salt;
+        }
+        hashPasswordBatchRaw(batch->words, salts, n, hash);
+        w->hashed += n;
+
+        for (int i = 0; i < n; i++) {
+            int d = findDigest(targets, group, hash[i]);
+            if (d >= 0 && __atomic_load_n(&engine->cracked[d], __ATOMIC_RELAXED) == 0
+                    && __atomic_exchange_n(&engine->cracked[d], 1, __ATOMIC_ACQ_REL) == 0) {
+                w->matched += crackDigest(engine, w->id, d, batch->first + i,
+                                          batch->words[i]);
+            }
+        }
+    }
+    __atomic_sub_fetch(&batch->remaining, 1, __ATOMIC_RELEASE);
+
+    // If the reader is done and this was the group's last batch, no more matches can
+    // come for its users. finishEngine() makes the same check after setting finished,
+    // so one of us always sees it.
+    long long done = __atomic_add_fetch(&engine->groupBatches[group], 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&engine->finished, __ATOMIC_SEQ_CST)
+            && done == totalPublished(engine)) {
+        finishGroup(engine->writer, group);
+    }
+}
+
+/**
+ * Claims the next published batch from one ring, if there is one, and pushes a task
+ * for each salt group onto this worker's deque.
+ * @param w the worker
+ * @param claimed the ring's count of claimed batches
+ * @param published the ring's count of published batches
+ * @param base index of the ring's first slot
+ * @param size number of slots in the ring
+ * @return true if a batch was claimed
+ */
+static bool claimFrom(Worker *w, long long *claimed, long long *published, int base,
+                      int size)
+{
+    Engine *engine = w->engine;
+    long long c = __atomic_load_n(claimed, __ATOMIC_ACQUIRE);
+    while (c < __atomic_load_n(published, __ATOMIC_ACQUIRE)) {
+        if (__atomic_compare_exchange_n(claimed, &c, c + 1, false,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            int slot = base + c % size;
+            // Push in reverse, so this worker pops the groups in order. Retired
+            // groups get no task, but still count as hashed with this batch.
+            int skipped = 0;
+            for (int g = engine->targets->groupCount - 1; g >= 0; g--) {
+                if (__atomic_load_n(&engine->groupLeft[g], __ATOMIC_RELAXED) == 0) {
+                    __atomic_add_fetch(&engine->groupBatches[g], 1, __ATOMIC_SEQ_CST);
+                    skipped++;
+                } else if (!pushTask(&w->deque, makeTask(slot, g))) {
+                    runTask(w, makeTask(slot, g));
+                }
+            }
+            if (skipped > 0) {
+                __atomic_sub_fetch(&engine->ring[slot].remaining, skipped, __ATOMIC_RELEASE);
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Claims the next published batch, taking loopback batches ahead of the rest.
+ * @param w the worker
+ * @return true if a batch was claimed
+ */
+static bool claimBatch(Worker *w)
+{
+    Engine *engine = w->engine;
+    return claimFrom(w, &engine->loopClaimed, &engine->loopPublished, RING_BATCHES,
+                     LOOP_BATCHES)
+        || claimFrom(w, &engine->claimed, &engine->published, 0, RING_BATCHES);
+}
+
+/**
+ * Tries to steal a task from one of the other workers, starting from a random one.
+ * @param w the idle worker
+ * @return the stolen task, or NO_TASK if every other deque stayed empty
+ */
+static Task stealAny(Worker *w)
+{
+    Engine *engine = w->engine;
+    for (int round = 0; round < STEAL_ROUNDS; round++) {
+        w->seed = w->seed * 1103515245U + 12345U;
+        int start = (w->seed >> 16) % engine->workerCount;
+        for (int i = 0; i < engine->workerCount; i++) {
+            Worker *victim = &engine->workers[(start + i) % engine->workerCount];
+            if (victim != w) {
+                Task task = stealTask(&victim->deque);
+                if (task != NO_TASK) {
+                    return task;
+                }
+            }
+        }
+    }
+    return NO_TASK;
+}
+
+/**
+ * Runs tasks from this worker's own deque, claims new batches when it runs out, and
+ * steals from the other workers when there are no new batches. Returns once the
+ * reader is finished and there's nothing left to claim or steal.
+ * @param arg the worker
+ * @return NULL
+ */
+static void *workerMain(void *arg)
+{
+    Worker *w = (Worker *) arg;
+    Engine *engine = w->engine;
+    int spins = 0;
+    for (;;) {
+        Task task = popTask(&w->deque);
+        if (task != NO_TASK) {
+            runTask(w, task);
+            spins = 0;
+            continue;
+        }
+        if (claimBatch(w)) {
+            spins = 0;
+            continue;
+        }
+        task = stealAny(w);
+        if (task != NO_TASK) {
+            runTask(w, task);
+            spins = 0;
+            continue;
+        }
+
+        bool finished = __atomic_load_n(&engine->finished, __ATOMIC_ACQUIRE);
+        if (finished && __atomic_load_n(&engine->claimed, __ATOMIC_ACQUIRE)
+                >= __atomic_load_n(&engine->published, __ATOMIC_ACQUIRE)
+                && __atomic_load_n(&engine->loopClaimed, __ATOMIC_ACQUIRE)
+                >= __atomic_load_n(&engine->loopPublished, __ATOMIC_ACQUIRE)) {
+            break;
+        }
+        idleWait(&spins);
+    }
+    return NULL;
+}
+
+/**
+ * Waits a moment for another thread. A short spin catches work that's about to turn
+ * up; after that, sleeping leaves the core to the reader or anything else that needs
+ * it, still without taking a lock.
+ * @param spins number of waits so far
+ */
+void idleWait(int *spins)
+{
+    if (*spins < SPIN_LIMIT) {
+        (*spins)++;
+        sched_yield();
+    } else {
+        struct timespec idle = { 0, IDLE_NANOS };
+        nanosleep(&idle, NULL);
+    }
+}
+
+/**
+ * Returns the number of CPUs online.
+ * @return the number of CPUs, at least 1
+ */
+int onlineCpus()
+{
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int) n : 1;
+}
+
+/**
+ * Starts an engine and its worker threads. The workers wait for batches until the
+ * engine is finished.
+ * @param targets the users to crack
+ * @param threads number of worker threads
+ * @param out where the matched users are written
+ * @param pot potfile for newly cracked passwords, or NULL
+ * @return the new engine
+ */
+Engine *startEngine(TargetSet const *targets, int threads, FILE *out, Potfile *pot)
+{
+    Engine *engine = (Engine *) calloc(1, sizeof(Engine));
+    engine->targets = targets;
+    engine->ring = (WordBatch *) calloc(RING_BATCHES + LOOP_BATCHES, sizeof(WordBatch));
+    engine->groupBatches = (long long *) calloc(targets->groupCount + 1, sizeof(long long));
+    engine->cracked = (int *) calloc(targets->digestCount + 1, sizeof(int));
+    engine->groupLeft = (int *) calloc(targets->groupCount + 1, sizeof(int));
+    for (int g = 0; g < targets->groupCount; g++) {
+        engine->groupLeft[g] = targets->groups[g].count;
+    }
+    engine->digestsLeft = targets->digestCount;
+    engine->crackedWords = (char (*)[PW_LIMIT + 1]) calloc(targets->digestCount + 1,
+                                                           PW_LIMIT + 1);
+    engine->crackedDigests = (int *) calloc(targets->digestCount + 1, sizeof(int));
+    engine->crackedReady = (int *) calloc(targets->digestCount + 1, sizeof(int));
+    engine->doneCursor = -1;
+    engine->workerCount = threads > 0 ? threads : 1;
+    // The writer has a queue for each worker, and one more for the reader.
+    engine->writer = startWriter(targets, engine->workerCount + 1, out, pot);
+    engine->workers = (Worker *) calloc(engine->workerCount, sizeof(Worker));
+
+    for (int i = 0; i < engine->workerCount; i++) {
+        Worker *w = &engine->workers[i];
+        w->engine = engine;
+        w->id = i;
+        w->seed = i + 1;
+        initDeque(&w->deque, targets->groupCount + 1);
+    }
+    for (int i = 0; i < engine->workerCount; i++) {
+        pthread_create(&engine->workers[i].thread, NULL, workerMain, &engine->workers[i]);
+    }
+    return engine;
+}
+
+/**
+ * Reports a digest whose password is known without hashing anything, as if the
+ * reader had cracked it. Known passwords are looped back like any others.
+ * @param engine the engine
+ * @param digest index of the digest
+ * @param password its password
+ */
+void knownPassword(Engine *engine, int digest, char const *password)
+{
+    if (__atomic_exchange_n(&engine->cracked[digest], 1, __ATOMIC_ACQ_REL) == 0) {
+        engine->knownCount += crackDigest(engine, engine->workerCount, digest, -1, password);
+    }
+}
+
+/**
+ * Reports whether every digest has been cracked, in which case there's no point in
+ * reading any more candidates.
+ * @param engine the engine
+ * @return true if nothing is left to crack
+ */
+bool engineSolved(Engine *engine)
+{
+    return __atomic_load_n(&engine->digestsLeft, __ATOMIC_ACQUIRE) == 0;
+}
+
+/**
+ * Reports whether the workers have finished every batch published so far.
+ * @param engine the engine
+ * @return true if there's no work left in either ring
+ */
+bool engineIdle(Engine *engine)
+{
+    long long total = totalPublished(engine);
+    for (int g = 0; g < engine->targets->groupCount; g++) {
+        if (__atomic_load_n(&engine->groupBatches[g], __ATOMIC_SEQ_CST) != total) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Moves past the main ring batches that have finished since the last call, in the
+ * order they were published.
+ * @param engine the engine
+ */
+static void advanceDone(Engine *engine)
+{
+    while (engine->doneBatches < engine->published) {
+        WordBatch *batch = &engine->ring[engine->doneBatches % RING_BATCHES];
+        if (__atomic_load_n(&batch->remaining, __ATOMIC_ACQUIRE) > 0) {
+            break;
+        }
+        engine->doneCursor = batch->cursor;
+        engine->doneBatches++;
+    }
+}
+
+/**
+ * Finds how far the candidates have been hashed without a gap.
+ * @param engine the engine
+ * @return the cursor of the last finished batch with none unfinished before it, or -1
+ */
+long long engineCursor(Engine *engine)
+{
+    advanceDone(engine);
+    return engine->doneCursor;
+}
+
+/**
+ * Looks up a cracked password by the order it was cracked in.
+ * @param engine the engine
+ * @param k index of the password, in the order they were cracked
+ * @param password where the password is stored
+ * @return index of the password's digest, or -1 if it isn't ready
+ */
+int crackedPassword(Engine *engine, int k, char password[PW_LIMIT + 1])
+{
+    if (k >= __atomic_load_n(&engine->crackedCount, __ATOMIC_ACQUIRE)
+            || !__atomic_load_n(&engine->crackedReady[k], __ATOMIC_ACQUIRE)) {
+        return -1;
+    }
+    strcpy(password, engine->crackedWords[k]);
+    return engine->crackedDigests[k];
+}
+
+/**
+ * Takes the next password cracked since the last call, for the reader to loop back.
+ * @param engine the engine
+ * @param password where the password is stored
+ * @return the length of the password, or -1 if there isn't a new one yet
+ */
+int takeCracked(Engine *engine, char password[PW_LIMIT + 1])
+{
+    if (crackedPassword(engine, engine->crackedTaken, password) < 0) {
+        return -1;
+    }
+    engine->crackedTaken++;
+    return strlen(password);
+}
+
+/**
+ * Waits until a ring slot is free for the reader to fill, and empties it.
+ * @param batch the slot
+ * @return the batch
+ */
+static WordBatch *emptyBatch(WordBatch *batch)
+{
+    int spins = 0;
+    while (__atomic_load_n(&batch->remaining, __ATOMIC_ACQUIRE) > 0) {
+        idleWait(&spins);
+    }
+    batch->count = 0;
+    return batch;
+}
+
+/**
+ * Returns the next batch in the ring for the reader to fill. If the workers are still
+ * using it, this yields until they're done with it, which keeps the reader from
+ * getting more than a ring's worth of batches ahead.
+ * @param engine the engine
+ * @return an empty batch
+ */
+WordBatch *nextBatch(Engine *engine)
+{
+    // The batch this slot held is finished now, so remember where it got to before
+    // the slot is reused.
+    WordBatch *batch = emptyBatch(&engine->ring[engine->published % RING_BATCHES]);
+    advanceDone(engine);
+    return batch;
+}
+
+/**
+ * Returns the next batch in the loopback ring for the reader to fill.
+ * @param engine the engine
+ * @return an empty batch
+ */
+WordBatch *nextLoopbackBatch(Engine *engine)
+{
+    return emptyBatch(&engine->ring[RING_BATCHES + engine->loopPublished % LOOP_BATCHES]);
+}
+
+/**
+ * Hands a batch filled by the reader to the workers. Its position in the stream of
+ * candidates is set here, so a loopback batch filled while another batch was being
+ * filled doesn't share its positions.
+ * @param engine the engine
+ * @param batch a batch returned by nextBatch() or nextLoopbackBatch()
+ */
+void publishBatch(Engine *engine, WordBatch *batch)
+{
+    batch->first = engine->nextFirst;
+    engine->nextFirst += batch->count;
+    batch->remaining = engine->targets->groupCount;
+    if (batch >= engine->ring + RING_BATCHES) {
+        __atomic_store_n(&engine->loopPublished, engine->loopPublished + 1, __ATOMIC_RELEASE);
+    } else {
+        __atomic_store_n(&engine->published, engine->published + 1, __ATOMIC_RELEASE);
+    }
+}
+
+/**
+ * Tells the workers there are no more batches, finishes every salt group that's
+ * already caught up, and waits for the workers and the writer to finish. The engine
+ * is freed.
+ * @param engine the engine
+ * @param result where the statistics are stored
+ */
+void finishEngine(Engine *engine, CrackResult *result)
+{
+    __atomic_store_n(&engine->finished, 1, __ATOMIC_SEQ_CST);
+    long long total = totalPublished(engine);
+    for (int g = 0; g < engine->targets->groupCount; g++) {
+        if (__atomic_load_n(&engine->groupBatches[g], __ATOMIC_SEQ_CST) == total) {
+            finishGroup(engine->writer, g);
+        }
+    }
+    for (int i = 0; i < engine->workerCount; i++) {
+        pthread_join(engine->workers[i].thread, NULL);
+    }
+    result->written = finishWriter(engine->writer);
+
+    result->matchCount = engine->knownCount;
+    result->hashed = 0;
+    for (int i = 0; i < engine->workerCount; i++) {
+        result->matchCount += engine->workers[i].matched;
+        result->hashed += engine->workers[i].hashed;
+        freeDeque(&engine->workers[i].deque);
+    }
+
+    free(engine->workers);
+    free(engine->groupBatches);
+    free(engine->cracked);
+    free(engine->groupLeft);
+    free(engine->crackedWords);
+    free(engine->crackedDigests);
+    free(engine->crackedReady);
+    free(engine->ring);
+    free(engine);
+}
@@ -0,0 +1,114 @@
+/**
+ * @file engine.h
+ * @author Sean Leana (smleana)
+ * This file defines the cracking engine. A reader feeds batches of candidate words
+ * into the engine while a pool of worker threads hashes them against every salt group,
+ * so hashing starts on the first batch rather than after the whole dictionary is read.
+ * Matched users are written out in order while the workers are still hashing, and
+ * cracked hashes stop being looked for as soon as they're found. Cracked passwords
+ * can be looped back as candidates ahead of everything already queued.
+ */
+
+#ifndef _ENGINE_H_
+#define _ENGINE_H_
+
+#include "target.h"
+#include "writer.h"
+#include "potfile.h"
+#include <stdio.h>
+
+/** Number of candidate words in one batch. */
+#define BATCH_WORDS 64
+
+/** A batch of candidate words handed from the reader to the workers. */
+typedef struct {
+    /** Position of the first word in the stream of candidates. */
+    long long first;
+
+    /** Number of words in the batch. */
+    int count;
+
+    /** The words, each null terminated. They belong to the reader, which keeps them
+        until the engine is finished, or they're stored in text. */
+    char const *words[BATCH_WORDS];
+
+    /** Room for the words of a reader that has nowhere else to keep them. */
+    char text[BATCH_WORDS][PW_LIMIT + 1];
+
+    /** Number of salt groups still to be hashed with this batch; the batch can be
+        reused once this reaches zero. */
+    int remaining;
+
+    /** Where the reader's candidate generator stood just after this batch, so a
+        checkpoint knows where to pick up once the batch is done. */
+    long long cursor;
+} WordBatch;
+
+/** What a cracking run did. */
+typedef struct {
+    /** Number of matches found, and number of lines written for them. */
+    long long matchCount;
+    long long written;
+
+    /** Number of candidate hashes computed, across all workers. */
+    long long hashed;
+} CrackResult;
+
+/** A running engine; the details are private to the engine component. */
+typedef struct EngineStruct Engine;
+
+/** returns the number of CPUs online, the default number of worker threads */
+int onlineCpus();
+
+/** starts an engine with the given number of worker threads, cracking the given
+ * targets and writing the matched users to out, unless it's NULL, and appending newly
+ * cracked passwords to pot unless it's NULL. The targets must not change until the engine is
+ * finished. */
+Engine *startEngine( TargetSet const *targets, int threads, FILE *out, Potfile *pot );
+
+/** reports a digest whose password is already known, from the potfile or from
+ * another process, so its users are written out without it being cracked again.
+ * Only the reader may call this. */
+void knownPassword( Engine *engine, int digest, char const *password );
+
+/** waits a moment for another thread: yields the first few times, then sleeps, so a
+ * thread with nothing to do doesn't hold a core. spins counts the waits so far, and
+ * goes back to 0 once there's work again. */
+void idleWait( int *spins );
+
+/** returns true once every target has been cracked, so the reader can stop early */
+bool engineSolved( Engine *engine );
+
+/** returns an empty batch for the reader to fill, waiting for the workers to finish
+ * with one if they're all in use */
+WordBatch *nextBatch( Engine *engine );
+
+/** returns an empty batch in the loopback ring, whose batches the workers take
+ * ahead of any others, waiting if they're all in use */
+WordBatch *nextLoopbackBatch( Engine *engine );
+
+/** hands a filled batch from either ring to the workers */
+void publishBatch( Engine *engine, WordBatch *batch );
+
+/** stores the next password cracked since the last call and returns its length, or
+ * returns -1 if no new password has been cracked. Only the reader may call this. */
+int takeCracked( Engine *engine, char password[ PW_LIMIT + 1 ] );
+
+/** returns true if the workers have finished with every batch published so far */
+bool engineIdle( Engine *engine );
+
+/** returns the cursor of the last batch in the longest run of finished batches from
+ * the main ring, or -1 if no batch has finished yet. Every candidate before it has
+ * been hashed with every salt that needs it. Only the reader may call this. */
+long long engineCursor( Engine *engine );
+
+/** stores the k-th password cracked, counting known passwords, and returns the index
+ * of its digest, or returns -1 if it isn't ready. There are never more than one per
+ * digest, and a later one may be ready before an earlier one. */
+int crackedPassword( Engine *engine, int k, char password[ PW_LIMIT + 1 ] );
+
+/** tells the engine there are no more batches, waits for the workers and the writer
+ * to finish and stores statistics about the run in result. The engine is freed. */
+void finishEngine( Engine *engine, CrackResult *result );
+
+#endif
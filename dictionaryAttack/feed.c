@@ -0,0 +1,537 @@
+/**
+ * @file feed.c
+ * @author Sean Leana (smleana)
+ * This file fills the engine's batches with candidates. Words from the dictionary
+ * arena go into batches as pointers when there are no rules; otherwise each word is
+ * expanded by every rule straight into the batch's own storage, so the expanded list
+ * is never built anywhere. Mask candidates and pairs of words from two dictionaries
+ * are generated the same way. With a filter, each candidate is checked as it lands in
+ * the batch and simply not counted if it has been tried before.
+ *
+ * Loopback candidates are fed whenever a new batch is started, so a cracked password
+ * waits at most one batch before its variants go into the loopback ring, which the
+ * workers take from ahead of everything else. Checkpoints are saved at the same time,
+ * and a source resumed from one jumps straight to its cursor wherever it can, rather
+ * than generating the candidates before it.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "feed.h"
+#include "stream.h"
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+/**
+ * Checks whether there's any point feeding more candidates.
+ * @param feeder the feeder
+ * @return false once every target is cracked, the feeder is told to stop, or it's
+ * past the end of its range
+ */
+static bool keepGoing(Feeder *feeder)
+{
+    return feeder->cursor < feeder->end && !engineSolved(feeder->engine)
+        && (feeder->stop == NULL || !*feeder->stop);
+}
+
+/**
+ * Checks whether a candidate belongs to this feeder's range and shard.
+ * @param feeder the feeder
+ * @param unit the candidate's cursor
+ * @return true if the candidate is this feeder's to hash
+ */
+static bool ownCandidate(Feeder *feeder, long long unit)
+{
+    return unit < feeder->end
+        && (feeder->shards <= 1 || (unit / SHARD_BLOCK) % feeder->shards == feeder->shard);
+}
+
+/**
+ * Returns the number of candidates each word expands to.
+ * @param feeder the feeder
+ * @return the number of rules, or 1 if there aren't any
+ */
+static int expansions(Feeder *feeder)
+{
+    return feeder->rules != NULL ? feeder->rules->count : 1;
+}
+
+/**
+ * Checks whether a candidate should be hashed.
+ * @param feeder the feeder
+ * @param word the candidate
+ * @param len its length
+ * @return false if the filter has seen the candidate before
+ */
+static bool freshWord(Feeder *feeder, char const *word, int len)
+{
+    return feeder->dedup == NULL || firstSighting(feeder->dedup, word, len);
+}
+
+/**
+ * Adds one candidate to a loopback batch, publishing the batch and starting another
+ * if it's full.
+ * @param feeder the feeder
+ * @param batch pointer to the loopback batch being filled
+ * @param word the candidate, already stored in the batch's next text slot
+ */
+static void addLoopback(Feeder *feeder, WordBatch **batch, char *word)
+{
+    (*batch)->words[(*batch)->count++] = word;
+    feeder->looped++;
+    if ((*batch)->count == BATCH_WORDS) {
+        publishBatch(feeder->engine, *batch);
+        *batch = nextLoopbackBatch(feeder->engine);
+    }
+}
+
+/**
+ * Feeds every password cracked since the last call into the loopback ring, each
+ * followed by its variants under the loopback rules. The password itself skips the
+ * filter, since it was tried once already, but only against some of the salts.
+ * @param feeder the feeder
+ * @return true if there were any new passwords
+ */
+static bool pollLoopback(Feeder *feeder)
+{
+    char password[PW_LIMIT + 1];
+    int len = takeCracked(feeder->engine, password);
+    if (len < 0) {
+        return false;
+    }
+
+    WordBatch *batch = nextLoopbackBatch(feeder->engine);
+    for (; len >= 0; len = takeCracked(feeder->engine, password)) {
+        strcpy(batch->text[batch->count], password);
+        addLoopback(feeder, &batch, batch->text[batch->count]);
+        for (int r = 0; feeder->loopRules != NULL && r < feeder->loopRules->count; r++) {
+            char *text = batch->text[batch->count];
+            int n = applyRule(&feeder->loopRules->rules[r], password, len, text);
+            if (freshWord(feeder, text, n)) {
+                addLoopback(feeder, &batch, text);
+            }
+        }
+    }
+    if (batch->count > 0) {
+        publishBatch(feeder->engine, batch);
+    }
+    return true;
+}
+
+/**
+ * Returns the batch being filled, getting a new one from the engine if there isn't
+ * one. Cracked passwords are looped back first, and a checkpoint saved if it's time.
+ * @param feeder the feeder
+ * @return the batch
+ */
+static WordBatch *currentBatch(Feeder *feeder)
+{
+    if (feeder->batch == NULL) {
+        if (feeder->loopback) {
+            pollLoopback(feeder);
+        }
+        if (feeder->checkpoint != NULL) {
+            tickCheckpoint(feeder->checkpoint, feeder->engine, feeder->skip);
+        }
+        feeder->batch = nextBatch(feeder->engine);
+    }
+    return feeder->batch;
+}
+
+/**
+ * Publishes the current batch once it's full.
+ * @param feeder the feeder
+ */
+static void checkFull(Feeder *feeder)
+{
+    if (feeder->batch->count == BATCH_WORDS) {
+        flushFeed(feeder);
+    }
+}
+
+/**
+ * Starts feeding candidates to an engine.
+ * @param feeder the feeder to initialize
+ * @param engine the engine
+ * @param rules rules to expand each word with, or NULL
+ * @param dedup filter for candidates seen before, or NULL
+ */
+void startFeed(Feeder *feeder, Engine *engine, RuleSet const *rules, Dedup *dedup)
+{
+    feeder->engine = engine;
+    feeder->batch = NULL;
+    feeder->rules = rules != NULL && rules->count > 0 ? rules : NULL;
+    feeder->dedup = dedup != NULL && dedup->mode != DEDUP_OFF ? dedup : NULL;
+    feeder->loopback = false;
+    feeder->loopRules = NULL;
+    feeder->looped = 0;
+    feeder->cursor = 0;
+    feeder->skip = 0;
+    feeder->end = LLONG_MAX;
+    feeder->checkpoint = NULL;
+    feeder->stop = NULL;
+    feeder->shard = 0;
+    feeder->shards = 1;
+}
+
+/**
+ * Limits the next pass over a source to a range of candidates.
+ * @param feeder the feeder
+ * @param first cursor of the first candidate
+ * @param end cursor just past the last candidate
+ */
+void limitFeed(Feeder *feeder, long long first, long long end)
+{
+    feeder->skip = first;
+    feeder->end = end;
+}
+
+/**
+ * Limits the feeder to one shard's candidates.
+ * @param feeder the feeder
+ * @param shard index of the shard, from 0
+ * @param shards number of shards
+ */
+void shardFeed(Feeder *feeder, int shard, int shards)
+{
+    feeder->shard = shard;
+    feeder->shards = shards;
+}
+
+/**
+ * Sets up checkpoints, and where to resume from.
+ * @param feeder the feeder
+ * @param checkpoint checkpoints to save, or NULL
+ * @param skip number of candidates to skip
+ * @param stop flag that stops feeding once it's set, or NULL
+ */
+void resumeFeed(Feeder *feeder, Checkpoint *checkpoint, long long skip,
+                volatile sig_atomic_t const *stop)
+{
+    feeder->checkpoint = checkpoint;
+    feeder->skip = skip;
+    feeder->stop = stop;
+}
+
+/**
+ * Starts looping cracked passwords back as candidates.
+ * @param feeder the feeder
+ * @param rules rules to make variants of each password with, or NULL
+ */
+void startLoopback(Feeder *feeder, RuleSet const *rules)
+{
+    feeder->loopback = true;
+    feeder->loopRules = rules != NULL && rules->count > 0 ? rules : NULL;
+}
+
+/**
+ * Loops back cracked passwords after the last of the other candidates, until nothing
+ * new is being cracked. The workers are idle before the last look for new passwords,
+ * so no password they crack can be missed.
+ * @param feeder the feeder
+ */
+void drainLoopback(Feeder *feeder)
+{
+    flushFeed(feeder);
+    int spins = 0;
+    while (feeder->loopback && keepGoing(feeder)) {
+        bool idle = engineIdle(feeder->engine);
+        if (pollLoopback(feeder)) {
+            spins = 0;
+        } else if (idle) {
+            break;
+        } else {
+            idleWait(&spins);
+        }
+    }
+}
+
+/**
+ * Adds a word, or every expansion of it by the rules, to the current batch.
+ * @param feeder the feeder
+ * @param word the word, which doesn't need to be null terminated
+ * @param len length of the word
+ * @return false once every target is cracked, so there's no point going on
+ */
+bool feedWord(Feeder *feeder, char const *word, int len)
+{
+    // A word whose candidates are all before the checkpoint is only counted.
+    if (feeder->cursor + expansions(feeder) <= feeder->skip) {
+        feeder->cursor += expansions(feeder);
+        return keepGoing(feeder);
+    }
+
+    if (feeder->rules == NULL) {
+        if (ownCandidate(feeder, feeder->cursor++) && freshWord(feeder, word, len)) {
+            WordBatch *batch = currentBatch(feeder);
+            char *text = batch->text[batch->count];
+            memcpy(text, word, len);
+            text[len] = '\0';
+            batch->words[batch->count++] = text;
+            checkFull(feeder);
+        }
+    } else {
+        for (int r = 0; r < feeder->rules->count; r++) {
+            long long unit = feeder->cursor++;
+            if (unit < feeder->skip || !ownCandidate(feeder, unit)) {
+                continue;
+            }
+            WordBatch *batch = currentBatch(feeder);
+            char *text = batch->text[batch->count];
+            int n = applyRule(&feeder->rules->rules[r], word, len, text);
+            if (freshWord(feeder, text, n)) {
+                batch->words[batch->count++] = text;
+                checkFull(feeder);
+            }
+        }
+    }
+    return keepGoing(feeder);
+}
+
+/**
+ * Publishes the current batch, if it has any words in it.
+ * @param feeder the feeder
+ */
+void flushFeed(Feeder *feeder)
+{
+    if (feeder->batch != NULL && feeder->batch->count > 0) {
+        feeder->batch->cursor = feeder->cursor;
+        publishBatch(feeder->engine, feeder->batch);
+        feeder->batch = NULL;
+    }
+}
+
+/**
+ * Feeds the words of a dictionary. Without rules, the batches point straight into
+ * the dictionary's arena, and duplicates are squeezed out of each run of pointers.
+ * @param feeder the feeder
+ * @param dict the dictionary, which must outlive the engine
+ */
+void feedDictionary(Feeder *feeder, Dictionary const *dict)
+{
+    // Start with the word the checkpoint is in.
+    long long next = feeder->skip / expansions(feeder);
+    feeder->cursor = next * expansions(feeder);
+    char const *words[BATCH_WORDS];
+    int lens[BATCH_WORDS];
+    if (feeder->rules == NULL) {
+        flushFeed(feeder);
+        while (next < dict->count && keepGoing(feeder)) {
+            WordBatch *batch = currentBatch(feeder);
+            int n = dictionaryWords(dict, next, BATCH_WORDS - batch->count, words, lens);
+            for (int i = 0; i < n; i++) {
+                if (ownCandidate(feeder, next + i) && freshWord(feeder, words[i], lens[i])) {
+                    batch->words[batch->count++] = words[i];
+                }
+            }
+            next += n;
+            feeder->cursor = next;
+            checkFull(feeder);
+        }
+        flushFeed(feeder);
+        return;
+    }
+
+    bool more = true;
+    while (more && next < dict->count) {
+        int n = dictionaryWords(dict, next, BATCH_WORDS, words, lens);
+        for (int i = 0; i < n && more; i++) {
+            more = feedWord(feeder, words[i], lens[i]);
+        }
+        next += n;
+    }
+    flushFeed(feeder);
+}
+
+/**
+ * Files the words of a dictionary into lists by length, counting the words of each
+ * length first so each list is allocated once.
+ * @param right the lists to fill
+ * @param dict the dictionary of right-hand words
+ */
+void fileRightWords(RightWords *right, Dictionary const *dict)
+{
+    char const *words[BATCH_WORDS];
+    int lens[BATCH_WORDS];
+
+    right->total = dict->count;
+    for (int len = 0; len <= PW_LIMIT; len++) {
+        right->count[len] = 0;
+    }
+    for (long long next = 0; next < dict->count; ) {
+        int n = dictionaryWords(dict, next, BATCH_WORDS, words, lens);
+        for (int i = 0; i < n; i++) {
+            right->count[lens[i]]++;
+        }
+        next += n;
+    }
+    for (int len = 0; len <= PW_LIMIT; len++) {
+        right->byLen[len] = (char const **) malloc((right->count[len] + 1)
+                                                    * sizeof(char const *));
+        right->count[len] = 0;
+    }
+    for (long long next = 0; next < dict->count; ) {
+        int n = dictionaryWords(dict, next, BATCH_WORDS, words, lens);
+        for (int i = 0; i < n; i++) {
+            right->byLen[lens[i]][right->count[lens[i]]++] = words[i];
+        }
+        next += n;
+    }
+}
+
+/**
+ * Frees the lists of right-hand words.
+ * @param right the lists to free
+ */
+void freeRightWords(RightWords *right)
+{
+    for (int len = 0; len <= PW_LIMIT; len++) {
+        free(right->byLen[len]);
+    }
+}
+
+/**
+ * Feeds the pairs of words from two dictionaries. The right-hand words are filed by
+ * length, so each left-hand word only ever meets the right-hand words short enough
+ * to go with it, and pairs that don't fit are never even formed.
+ * @param feeder the feeder
+ * @param left the dictionary of first halves
+ * @param right the second halves, filed by length
+ */
+void feedCombinator(Feeder *feeder, Dictionary const *left, RightWords const *right)
+{
+    char const *words[BATCH_WORDS];
+    int lens[BATCH_WORDS];
+
+    // Every left-hand word has a place in the cursor for each right-hand word, even
+    // the ones too long to go with it. Start with the word the checkpoint is in.
+    long long perLeft = right->total * expansions(feeder);
+    long long start = perLeft > 0 ? feeder->skip / perLeft : left->count;
+    feeder->cursor = start * perLeft;
+
+    char pair[PW_LIMIT + 1];
+    bool more = true;
+    for (long long next = start; more && next < left->count; ) {
+        int n = dictionaryWords(left, next, BATCH_WORDS, words, lens);
+        for (int i = 0; i < n && more; i++) {
+            memcpy(pair, words[i], lens[i]);
+            for (int len = 0; len <= PW_LIMIT - lens[i] && more; len++) {
+                long long units = (long long) right->count[len] * expansions(feeder);
+                if (feeder->cursor + units <= feeder->skip) {
+                    feeder->cursor += units;
+                    continue;
+                }
+                for (int j = 0; j < right->count[len] && more; j++) {
+                    memcpy(pair + lens[i], right->byLen[len][j], len);
+                    more = feedWord(feeder, pair, lens[i] + len);
+                }
+            }
+            if (more) {
+                feeder->cursor = (next + i + 1) * perLeft;
+            }
+        }
+        next += n;
+    }
+    flushFeed(feeder);
+}
+
+/**
+ * Finds the first candidate, from a given one on, in a block that belongs to this
+ * feeder's shard.
+ * @param feeder the feeder
+ * @param unit the candidate's cursor
+ * @return the cursor of the candidate, which is unit itself if it's in one of the
+ * shard's blocks
+ */
+static long long nextOwned(Feeder *feeder, long long unit)
+{
+    if (feeder->shards <= 1) {
+        return unit;
+    }
+    long long block = unit / SHARD_BLOCK;
+    long long ahead = (feeder->shard - block % feeder->shards + feeder->shards)
+        % feeder->shards;
+    return ahead == 0 ? unit : (block + ahead) * SHARD_BLOCK;
+}
+
+/**
+ * Feeds part of a mask's keyspace. The first candidate is decoded from its index and
+ * the rest are stepped to from there. A shard jumps over the blocks that aren't its
+ * own and decodes again where its next block starts, so it only ever generates its
+ * own share. A batch never mixes candidates of different lengths, so its lanes all
+ * share one block layout.
+ * @param feeder the feeder
+ * @param mask the mask
+ * @param first index of the first candidate
+ * @param count number of candidates
+ */
+void feedMask(Feeder *feeder, Mask const *mask, long long first, long long count)
+{
+    char word[PW_LIMIT + 1];
+    int len = -1;
+    bool decode = true;
+    bool more = true;
+    long long last = first + count < feeder->end ? first + count : feeder->end;
+    feeder->cursor = first;
+    for (long long i = first; i < last && more; ) {
+        long long next = nextOwned(feeder, i);
+        if (next != i) {
+            i = next;
+            decode = true;
+            feeder->cursor = i < last ? i : last;
+            more = keepGoing(feeder);
+            continue;
+        }
+        if (decode || !nextMaskCandidate(mask, word, len)) {
+            int n = maskCandidate(mask, i, word);
+            if (n != len) {
+                flushFeed(feeder);
+            }
+            len = n;
+            decode = false;
+        }
+        WordBatch *batch = currentBatch(feeder);
+        memcpy(batch->text[batch->count], word, len + 1);
+        batch->words[batch->count] = batch->text[batch->count];
+        batch->count++;
+        feeder->cursor = ++i;
+        if (batch->count == BATCH_WORDS) {
+            flushFeed(feeder);
+            more = keepGoing(feeder);
+        }
+    }
+    flushFeed(feeder);
+}
+
+/**
+ * Feeds the words of a stream as they arrive. Rather than wait on the stream with
+ * candidates in hand, this passes on a batch that isn't full yet. A signal that
+ * interrupts the wait is a chance to notice the feeder has been told to stop, even
+ * if nothing more ever arrives.
+ * @param feeder the feeder
+ * @param fd the file descriptor the words come from
+ * @return false if a word contains a space or is longer than PW_LIMIT
+ */
+bool feedStream(Feeder *feeder, int fd)
+{
+    WordStream stream;
+    openWordStream(&stream, fd);
+    char word[PW_LIMIT + 1];
+    int status = STREAM_WORD;
+    bool more = true;
+    while ((status == STREAM_WORD || status == STREAM_INTERRUPTED) && more) {
+        if (!wordReady(&stream)) {
+            flushFeed(feeder);
+        }
+        status = readStreamWord(&stream, word);
+        if (status == STREAM_WORD) {
+            more = feedWord(feeder, word, strlen(word));
+        } else if (status == STREAM_INTERRUPTED) {
+            more = keepGoing(feeder);
+        }
+    }
+    flushFeed(feeder);
+    closeWordStream(&stream);
+    return status != STREAM_INVALID;
+}
@@ -0,0 +1,141 @@
+/**
+ * @file feed.h
+ * @author Sean Leana (smleana)
+ * This file defines the feeder, which fills the engine's batches with candidate words
+ * from a dictionary or a stream, expanding each word with mangling rules on the way
+ * if there are any, and dropping candidates that have already been tried. Passwords
+ * cracked along the way can be looped back in as candidates of their own.
+ *
+ * Every candidate a source generates has a position, its cursor, counting each rule's
+ * expansion of each word separately, so a job can be checkpointed and picked up again
+ * at any candidate. The same positions split a job into shards: runs of SHARD_BLOCK
+ * candidates are dealt out to the shards in turn, so each shard gets its share of
+ * every part of the source, short words and long ones alike.
+ */
+
+#ifndef _FEED_H_
+#define _FEED_H_
+
+#include "engine.h"
+#include "dictionary.h"
+#include "rules.h"
+#include "mask.h"
+#include "dedup.h"
+#include "checkpoint.h"
+#include <stdbool.h>
+#include <signal.h>
+
+/** Number of consecutive candidates that go to the same shard. */
+#define SHARD_BLOCK 64
+
+/** State for filling the engine's batches. */
+typedef struct {
+    /** The engine the candidates go to. */
+    Engine *engine;
+
+    /** The batch being filled, or NULL if there isn't one. */
+    WordBatch *batch;
+
+    /** Rules each word is expanded with, or NULL to use the words as they are. */
+    RuleSet const *rules;
+
+    /** Filter that turns away candidates seen before, or NULL to hash them all. */
+    Dedup *dedup;
+
+    /** Whether cracked passwords are looped back, and the rules their variants are
+        made with, or NULL to loop back only the passwords themselves. */
+    bool loopback;
+    RuleSet const *loopRules;
+
+    /** Number of candidates looped back. */
+    long long looped;
+
+    /** Number of candidates generated so far, how many of them to skip because a
+        checkpoint says they're done or they're before a lease, and the cursor to
+        stop at. */
+    long long cursor;
+    long long skip;
+    long long end;
+
+    /** Checkpoints to save as batches are started, or NULL. */
+    Checkpoint *checkpoint;
+
+    /** Flag a signal handler sets to stop feeding early, or NULL. */
+    volatile sig_atomic_t const *stop;
+
+    /** Index of this job's shard, from 0, and the number of shards. */
+    int shard;
+    int shards;
+} Feeder;
+
+/** The right-hand words of a combinator job, filed into lists by length once, so
+    every pass over the job can share them. */
+typedef struct {
+    /** Number of words, of every length. */
+    long long total;
+
+    /** The words of each length, pointing into the dictionary, and how many there
+        are of each. */
+    char const **byLen[PW_LIMIT + 1];
+    int count[PW_LIMIT + 1];
+} RightWords;
+
+/** starts feeding candidates to the given engine, expanding each word with the given
+ * rules unless rules is NULL or empty, and passing each candidate through the given
+ * filter unless dedup is NULL */
+void startFeed( Feeder *feeder, Engine *engine, RuleSet const *rules, Dedup *dedup );
+
+/** saves the given checkpoints as batches are started, skips the first skip
+ * candidates, and stops early once the stop flag is set. Either pointer can be NULL. */
+void resumeFeed( Feeder *feeder, Checkpoint *checkpoint, long long skip,
+                 volatile sig_atomic_t const *stop );
+
+/** makes the next pass over a source feed only the candidates from cursor first up
+ * to end */
+void limitFeed( Feeder *feeder, long long first, long long end );
+
+/** feeds only the candidates that belong to the given shard, counting from 0, of the
+ * given number of shards */
+void shardFeed( Feeder *feeder, int shard, int shards );
+
+/** loops every password cracked from now on back in as a candidate, ahead of the
+ * rest, along with its variants under the given rules unless rules is NULL */
+void startLoopback( Feeder *feeder, RuleSet const *rules );
+
+/** keeps looping back cracked passwords until the workers have run out of work and
+ * no new passwords turn up, or every target is cracked */
+void drainLoopback( Feeder *feeder );
+
+/** adds a word of len characters, or every expansion of it, to the current batch,
+ * publishing batches as they fill. Returns false once every target is cracked or the
+ * feeder has been told to stop. */
+bool feedWord( Feeder *feeder, char const *word, int len );
+
+/** publishes the current batch, even if it isn't full */
+void flushFeed( Feeder *feeder );
+
+/** feeds every word of a dictionary, stopping early once every target is cracked */
+void feedDictionary( Feeder *feeder, Dictionary const *dict );
+
+/** files the words of a dictionary by length to be the right-hand words of a
+ * combinator job. They point into the dictionary, so it has to stay open until
+ * they're freed. */
+void fileRightWords( RightWords *right, Dictionary const *dict );
+
+/** frees the lists of right-hand words */
+void freeRightWords( RightWords *right );
+
+/** feeds every pairing of a word from left followed by a word from right that fits
+ * in PW_LIMIT characters, stopping early once every target is cracked */
+void feedCombinator( Feeder *feeder, Dictionary const *left, RightWords const *right );
+
+/** feeds count candidates from a mask's keyspace, starting with the one at index
+ * first, which is also its cursor, stopping early once every target is cracked. A
+ * mask never repeats a candidate, so these don't go through the filter. */
+void feedMask( Feeder *feeder, Mask const *mask, long long first, long long count );
+
+/** feeds the words of a stream as they arrive, until it ends or every target is
+ * cracked. Returns false if a word in the stream isn't valid. */
+bool feedStream( Feeder *feeder, int fd );
+
+#endif
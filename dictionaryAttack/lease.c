@@ -0,0 +1,125 @@
+/**
+ * @file lease.c
+ * @author Sean Leana (smleana)
+ * This file keeps the table of leases. Only the leases that are out are stored, and
+ * there are about as many of them as there are workers, so a linear search through
+ * them is as fast as anything.
+ */
+
+#include "lease.h"
+#include <stdlib.h>
+
+/** Initial number of leases the table has room for. */
+#define INITIAL_LEASES 16
+
+/**
+ * Starts handing out the candidates of a job.
+ * @param table the table to initialize
+ * @param keyspace number of candidates in the job
+ * @param timeout number of seconds a worker has to finish a lease
+ */
+void initLeases(LeaseTable *table, long long keyspace, int timeout)
+{
+    table->keyspace = keyspace;
+    table->next = 0;
+    table->capacity = INITIAL_LEASES;
+    table->leases = (Lease *) malloc(table->capacity * sizeof(Lease));
+    table->count = 0;
+    table->timeout = timeout;
+    table->nextId = 1;
+    table->granted = 0;
+    table->reissued = 0;
+}
+
+/**
+ * Grants a worker a lease. An expired lease goes first, so a range a worker gave up
+ * on is never left until the end of the job.
+ * @param table the table
+ * @param owner the worker asking
+ * @param size largest number of fresh candidates to grant
+ * @param now the current time
+ * @param lease where the lease is stored
+ * @return false if every candidate is already leased
+ */
+bool grantLease(LeaseTable *table, int owner, long long size, time_t now, Lease *lease)
+{
+    for (int i = 0; i < table->count; i++) {
+        if (table->leases[i].deadline <= now) {
+            table->leases[i].owner = owner;
+            table->leases[i].deadline = now + table->timeout;
+            table->granted++;
+            table->reissued++;
+            *lease = table->leases[i];
+            return true;
+        }
+    }
+    if (table->next >= table->keyspace) {
+        return false;
+    }
+
+    if (table->count == table->capacity) {
+        table->capacity *= 2;
+        table->leases = (Lease *) realloc(table->leases, table->capacity * sizeof(Lease));
+    }
+    Lease *fresh = &table->leases[table->count++];
+    fresh->id = table->nextId++;
+    fresh->start = table->next;
+    fresh->end = size < table->keyspace - table->next ? table->next + size : table->keyspace;
+    fresh->owner = owner;
+    fresh->deadline = now + table->timeout;
+    table->next = fresh->end;
+    table->granted++;
+    *lease = *fresh;
+    return true;
+}
+
+/**
+ * Marks a lease finished.
+ * @param table the table
+ * @param id the lease's id
+ * @return false if the lease isn't outstanding
+ */
+bool finishLease(LeaseTable *table, long long id)
+{
+    for (int i = 0; i < table->count; i++) {
+        if (table->leases[i].id == id) {
+            table->leases[i] = table->leases[--table->count];
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Lets a worker's leases expire.
+ * @param table the table
+ * @param owner the worker
+ */
+void dropOwner(LeaseTable *table, int owner)
+{
+    for (int i = 0; i < table->count; i++) {
+        if (table->leases[i].owner == owner) {
+            table->leases[i].deadline = 0;
+        }
+    }
+}
+
+/**
+ * Reports whether the whole job is done.
+ * @param table the table
+ * @return true once every candidate is covered by a finished lease
+ */
+bool leasesDone(LeaseTable const *table)
+{
+    return table->next >= table->keyspace && table->count == 0;
+}
+
+/**
+ * Frees a table.
+ * @param table the table
+ */
+void freeLeases(LeaseTable *table)
+{
+    free(table->leases);
+    table->leases = NULL;
+}
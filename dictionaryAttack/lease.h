@@ -0,0 +1,80 @@
+/**
+ * @file lease.h
+ * @author Sean Leana (smleana)
+ * This file defines the table of leases a coordinator hands out. A job's candidates
+ * are numbered by their cursor, and a lease is a range of cursors given to one worker
+ * for a while. Ranges are cut from the front of the keyspace as they're asked for, so
+ * each worker can ask for as much as it gets through in a few seconds, and a lease
+ * that isn't finished in time is handed to the next worker that asks.
+ */
+
+#ifndef _LEASE_H_
+#define _LEASE_H_
+
+#include <stdbool.h>
+#include <time.h>
+
+/** Default number of seconds a worker has to finish a lease. */
+#define LEASE_SECONDS 120
+
+/** A range of candidates handed to a worker. */
+typedef struct {
+    /** Number that identifies the lease. */
+    long long id;
+
+    /** Cursor of the first candidate, and one past the last one. */
+    long long start;
+    long long end;
+
+    /** Which worker holds the lease, and when it runs out. */
+    int owner;
+    time_t deadline;
+} Lease;
+
+/** The leases of one job. */
+typedef struct {
+    /** Number of candidates in the job, and the cursor of the first one no lease has
+        covered yet. */
+    long long keyspace;
+    long long next;
+
+    /** Leases handed out and not finished yet. */
+    Lease *leases;
+    int count;
+    int capacity;
+
+    /** Number of seconds a worker has to finish a lease. */
+    int timeout;
+
+    /** Id of the next lease. */
+    long long nextId;
+
+    /** Number of leases granted, and how many of them were expired ones granted
+        again. */
+    long long granted;
+    long long reissued;
+} LeaseTable;
+
+/** starts handing out the candidates of a job with the given keyspace, with the given
+ * number of seconds to finish each lease */
+void initLeases( LeaseTable *table, long long keyspace, int timeout );
+
+/** grants the given worker a lease, storing it in lease: an expired one if there is
+ * one, or else up to size fresh candidates. Returns false if every candidate is
+ * already leased. */
+bool grantLease( LeaseTable *table, int owner, long long size, time_t now, Lease *lease );
+
+/** marks the lease with the given id finished. Returns false if it isn't outstanding,
+ * like a lease finished by another worker after it expired. */
+bool finishLease( LeaseTable *table, long long id );
+
+/** lets every lease the given worker holds expire at once, like when it goes away */
+void dropOwner( LeaseTable *table, int owner );
+
+/** returns true once every candidate has been covered by a finished lease */
+bool leasesDone( LeaseTable const *table );
+
+/** frees the table */
+void freeLeases( LeaseTable *table );
+
+#endif
@@ -0,0 +1,151 @@
+/**
+ * @file mask.c
+ * @author Sean Leana (smleana)
+ * This file parses masks and walks their keyspaces. A candidate's index is a number
+ * written in mixed radix, with one digit per position and the last position changing
+ * fastest, so decoding an index takes one division per position. Walking the
+ * keyspace in order is an odometer: bump the last position, carrying into the ones
+ * before it. Each length is a run of its own, so every batch of candidates from one
+ * length shares a block layout.
+ *
+ * The placeholders are ?l for lowercase letters, ?u for uppercase letters, ?d for
+ * digits, ?s for the printable symbols including space, ?a for all of these, and ??
+ * for a question mark. Any other character stands for itself.
+ */
+
+#include "mask.h"
+#include <string.h>
+#include <limits.h>
+
+/** Lowercase letters. */
+#define LOWER "abcdefghijklmnopqrstuvwxyz"
+
+/** Uppercase letters. */
+#define UPPER "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+
+/** Digits. */
+#define DIGITS "0123456789"
+
+/** Printable symbols, including space. */
+#define SYMBOLS " !\"#$%&'()*+,-./:;<=>?@[\\]^_`{|}~"
+
+/**
+ * Parses a mask.
+ * @param mask the mask to fill in
+ * @param text the mask
+ * @param increment true to include every prefix of the mask, shortest first
+ * @return false if the mask isn't valid or its keyspace is too big
+ */
+bool parseMask(Mask *mask, char const *text, bool increment)
+{
+    mask->length = 0;
+    for (int i = 0; text[i] != '\0'; i++) {
+        if (mask->length >= PW_LIMIT) {
+            return false;
+        }
+        char *set = mask->charset[mask->length];
+        if (text[i] != '?') {
+            set[0] = text[i];
+            set[1] = '\0';
+        } else {
+            switch (text[++i]) {
+            case 'l':
+                strcpy(set, LOWER);
+                break;
+            case 'u':
+                strcpy(set, UPPER);
+                break;
+            case 'd':
+                strcpy(set, DIGITS);
+                break;
+            case 's':
+                strcpy(set, SYMBOLS);
+                break;
+            case 'a':
+                strcpy(set, LOWER UPPER DIGITS SYMBOLS);
+                break;
+            case '?':
+                strcpy(set, "?");
+                break;
+            default:
+                return false;
+            }
+        }
+        mask->size[mask->length++] = strlen(set);
+    }
+    if (mask->length == 0) {
+        return false;
+    }
+
+    // Count the candidates of each length, making sure the total can't overflow.
+    mask->minLength = increment ? 1 : mask->length;
+    long long total = 0;
+    long long count = 1;
+    for (int len = 1; len <= mask->length; len++) {
+        if (count > LLONG_MAX / mask->size[len - 1]) {
+            return false;
+        }
+        count *= mask->size[len - 1];
+        if (len >= mask->minLength) {
+            mask->lengthStart[len] = total;
+            if (total > LLONG_MAX - count) {
+                return false;
+            }
+            total += count;
+        }
+    }
+    mask->lengthStart[mask->length + 1] = total;
+    return true;
+}
+
+/**
+ * Returns the size of a mask's keyspace.
+ * @param mask the mask
+ * @return the number of candidates
+ */
+long long maskKeyspace(Mask const *mask)
+{
+    return mask->lengthStart[mask->length + 1];
+}
+
+/**
+ * Finds the candidate with a given index.
+ * @param mask the mask
+ * @param index index of the candidate, less than the keyspace
+ * @param out where the candidate is stored
+ * @return the length of the candidate
+ */
+int maskCandidate(Mask const *mask, long long index, char out[PW_LIMIT + 1])
+{
+    int len = mask->minLength;
+    while (index >= mask->lengthStart[len + 1]) {
+        len++;
+    }
+    index -= mask->lengthStart[len];
+    for (int i = len - 1; i >= 0; i--) {
+        out[i] = mask->charset[i][index % mask->size[i]];
+        index /= mask->size[i];
+    }
+    out[len] = '\0';
+    return len;
+}
+
+/**
+ * Moves a candidate on to the next one of the same length.
+ * @param mask the mask
+ * @param word the candidate, which is changed in place
+ * @param len length of the candidate
+ * @return false if there was no next candidate of this length
+ */
+bool nextMaskCandidate(Mask const *mask, char word[PW_LIMIT + 1], int len)
+{
+    for (int i = len - 1; i >= 0; i--) {
+        char const *next = strchr(mask->charset[i], word[i]) + 1;
+        if (*next != '\0') {
+            word[i] = *next;
+            return true;
+        }
+        word[i] = mask->charset[i][0];
+    }
+    return false;
+}
@@ -0,0 +1,54 @@
+/**
+ * @file mask.h
+ * @author Sean Leana (smleana)
+ * This file defines masks, which describe a brute-force keyspace one position at a
+ * time, like ?u?l?l?l?d?d for a capital letter, three lowercase letters and two
+ * digits. Every candidate in a mask's keyspace has an index, and any index can be
+ * turned into its candidate directly, so the keyspace can be split up or resumed
+ * anywhere.
+ */
+
+#ifndef _MASK_H_
+#define _MASK_H_
+
+#include "password.h"
+#include <stdbool.h>
+
+/** Largest number of characters one position of a mask can take. */
+#define CHARSET_LIMIT 95
+
+/** A parsed mask. */
+typedef struct {
+    /** The characters each position can take, and how many there are. */
+    char charset[ PW_LIMIT ][ CHARSET_LIMIT + 1 ];
+    int size[ PW_LIMIT ];
+
+    /** Number of positions. */
+    int length;
+
+    /** Shortest candidate; less than length if the mask is run incrementally, trying
+        each of its prefixes in turn. */
+    int minLength;
+
+    /** Index of the first candidate of each length, from minLength up to length + 1,
+        where the last entry is the size of the whole keyspace. */
+    long long lengthStart[ PW_LIMIT + 2 ];
+} Mask;
+
+/** parses a mask. If increment is true, the keyspace starts with the candidates of
+ * length 1 and works up to the whole mask. Returns false if the mask is empty, is
+ * longer than PW_LIMIT, or its keyspace doesn't fit in a long long. */
+bool parseMask( Mask *mask, char const *text, bool increment );
+
+/** returns the number of candidates in the mask's keyspace */
+long long maskKeyspace( Mask const *mask );
+
+/** stores the candidate with the given index in out, null terminated, and returns
+ * its length */
+int maskCandidate( Mask const *mask, long long index, char out[ PW_LIMIT + 1 ] );
+
+/** changes a candidate of the given length into the next one of the same length, and
+ * returns false if it was the last one */
+bool nextMaskCandidate( Mask const *mask, char word[ PW_LIMIT + 1 ], int len );
+
+#endif
@@ -5,7 +5,9 @@
  */
 
 #include "md5.h"
+#include "md5steps.h"
 #include <stdlib.h>
+#include <string.h>
 #include <stdio.h>  // Maybe for some debugging
 
 /** Function type for the f functions in the md5 algorithm. */
@@ -102,9 +104,9 @@ int gVersion3(int idx)
     return (7 * idx) % 16;
 }
 
-GFunction G[4] = { gVersion0, gVersion1, gVersion2, gVersion3 };
+static GFunction const G[4] = { gVersion0, gVersion1, gVersion2, gVersion3 };
 
-FFunction F[4] = { fVersion0, fVersion1, fVersion2, fVersion3 };
+static FFunction const F[4] = { fVersion0, fVersion1, fVersion2, fVersion3 };
 
 /**
  * This function implements the rotate left operation from the MD5 algorithm,
@@ -174,8 +176,65 @@ void padBlock(Block *block)
     appendByte(block, (origLenBits >> 56) & 0xFF);
 }
 
+// The four F functions with the round fixed, so each step can inline its own.
+#define SCALAR_F0( b, c, d ) ( ( ( b ) & ( c ) ) | ( ~( b ) & ( d ) ) )
+#define SCALAR_F1( b, c, d ) ( ( ( b ) & ( d ) ) | ( ( c ) & ~( d ) ) )
+#define SCALAR_F2( b, c, d ) ( ( b ) ^ ( c ) ^ ( d ) )
+#define SCALAR_F3( b, c, d ) ( ( c ) ^ ( ( b ) | ~( d ) ) )
+
+/** One MD5 step with the F function, message index, shift and noise all fixed at
+ * compile time. This does the same work as md5Iteration(), but leaves the A, B, C, D
+ * roles to the step list rather than shuffling the variables. */
+#define SCALAR_STEP( f, a, b, c, d, g, s, k ) \
+    a += SCALAR_F##f( b, c, d ) + M[ g ] + ( k ); \
+    a = ( ( a << ( s ) ) | ( a >> ( 32 - ( s ) ) ) ) + b;
+
+/**
+ * This function computes the MD5 hash of a block that has already been padded to
+ * 64 bytes and stores the result in the given hash array. All 64 steps are unrolled
+ * from md5steps.h, so there are no function pointer calls or table lookups. This is
+ * the scalar path used by md5Hash() and for the blocks md5HashBatch() can't fit
+ * into a full set of vector lanes. It gives the same result as running
+ * md5Iteration() for each of the 64 steps.
+ * @param block pointer to a padded block
+ * @param hash array the hash is stored in
+ */
+void md5HashPadded(Block const *block, byte hash[HASH_SIZE])
+{
+    word M[BLOCK_WORDS];
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    memcpy(M, block->data, BLOCK_SIZE);
+#else
+    for (int i = 0; i < BLOCK_WORDS; i++) {
+        M[i] = (word) block->data[i * 4]
+                | ((word) block->data[i * 4 + 1] << 8)
+                | ((word) block->data[i * 4 + 2] << 16)
+                | ((word) block->data[i * 4 + 3] << 24);
+    }
+#endif
+
+    word A = MD5_INITIAL_A;
+    word B = MD5_INITIAL_B;
+    word C = MD5_INITIAL_C;
+    word D = MD5_INITIAL_D;
+
+    MD5_STEPS( SCALAR_STEP )
+
+    word state[4] = { A + MD5_INITIAL_A, B + MD5_INITIAL_B, C + MD5_INITIAL_C, D + MD5_INITIAL_D };
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    memcpy(hash, state, HASH_SIZE);
+#else
+    for (int i = 0; i < 4; i++) {
+        hash[i * 4] = state[i] & 0xFF;
+        hash[i * 4 + 1] = (state[i] >> 8) & 0xFF;
+        hash[i * 4 + 2] = (state[i] >> 16) & 0xFF;
+        hash[i * 4 + 3] = (state[i] >> 24) & 0xFF;
+    }
+#endif
+}
+
 /** 
- * This is the only public function provided by the md5 component. It pads the given
+ * This is the main public function provided by the md5 component. It pads the given
  * input block, computes the MD5 hash using the helper functions above and stores the
  * result in the given hash array.
  * @param block 
@@ -183,48 +242,7 @@ void padBlock(Block *block)
  */
 void md5Hash(Block *block, byte hash[HASH_SIZE])
 {
-    word A = md5Initial[0];
-    word B = md5Initial[1];
-    word C = md5Initial[2];
-    word D = md5Initial[3];
-
-    word M[BLOCK_WORDS];
     padBlock(block);
     block->len = 64;
-
-    for (int i = 0; i < BLOCK_WORDS; i++) {
-        M[i] = (block->data[i * 4] & 0xFF)
-                | ((block->data[i * 4 + 1] & 0xFF) << 8)
-                | ((block->data[i * 4 + 2] & 0xFF) << 16)
-                | ((block->data[i * 4 + 3] & 0xFF) << 24);
-    }
-
-    for (int i = 0; i < 64; i++) {
-        md5Iteration(M, &A, &B, &C, &D, i);
-    }
-
-    A += md5Initial[0];
-    B += md5Initial[1];
-    C += md5Initial[2];
-    D += md5Initial[3];
-
-    hash[0] = (A & 0x000000FF);
-    hash[1] = (A & 0x0000FF00) >> 8;
-    hash[2] = (A & 0x00FF0000) >> 16;
-    hash[3] = (A & 0xFF000000) >> 24;
-
-    hash[4] = (B & 0x000000FF);
-    hash[5] = (B & 0x0000FF00) >> 8;
-    hash[6] = (B & 0x00FF0000) >> 16;
-    hash[7] = (B & 0xFF000000) >> 24;
-
-    hash[8] = (C & 0x000000FF);
-    hash[9] = (C & 0x0000FF00) >> 8;
-    hash[10] = (C & 0x00FF0000) >> 16;
-    hash[11] = (C & 0xFF000000) >> 24;
-
-    hash[12] = (D & 0x000000FF);
-    hash[13] = (D & 0x0000FF00) >> 8;
-    hash[14] = (D & 0x00FF0000) >> 16;
-    hash[15] = (D & 0xFF000000) >> 24;
+    md5HashPadded(block, hash);
 }
@@ -8,11 +8,34 @@
 #define _MD5_H_
 
 #include "block.h"
+#include <stdbool.h>
 
 /** Number of bytes in a MD5 hash */
 #define HASH_SIZE 16
 
+/** Most blocks md5HashBatch() hands to one md5 kernel call. */
+#define MD5_MAX_LANES 16
+
+/** pads a block out to 64 bytes the way md5 requires */
+void padBlock( Block *block );
+
 /** hashes with md5 */
 void md5Hash( Block *block, byte hash[ HASH_SIZE ] );
 
+/** hashes a block that has already been padded with padBlock() */
+void md5HashPadded( Block const *block, byte hash[ HASH_SIZE ] );
+
+/** hashes n independent, already padded blocks, several at a time in vector lanes,
+ * storing the hash of blocks[ i ] in hash[ i ]. The results are bit-for-bit the same
+ * as calling md5HashPadded() on each block. */
+void md5HashBatch( Block *blocks[], int n, byte hash[][ HASH_SIZE ] );
+
+/** picks the kernel md5HashBatch() uses: "scalar", "sse2", "avx2", "avx512", or
+ * NULL / "auto" for the widest one this CPU supports. Returns false if the name
+ * is unknown or the CPU can't run that kernel. */
+bool md5SelectKernel( char const *name );
+
+/** returns the name of the kernel md5HashBatch() is using */
+char const *md5KernelName();
+
 #endif
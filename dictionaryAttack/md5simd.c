@@ -0,0 +1,344 @@
+/**
+ * @file md5simd.c
+ * @author Sean Leana (smleana)
+ * This file hashes several independent blocks at once by running the MD5 steps in
+ * vector lanes, one block per 32-bit lane. SSE2 hashes 4 blocks per call, AVX2
+ * hashes 8 and AVX-512 hashes 16. Blocks given to these kernels must already be padded.
+ * The kernel is chosen at run time from what the CPU supports, so one binary runs on
+ * every host.
+ */
+
+#include "md5.h"
+#include "md5steps.h"
+#include <string.h>
+
+#if defined( __x86_64__ ) || defined( __i386__ )
+#include <immintrin.h>
+#define MD5_X86 1
+#endif
+
+/** Function type for a vector kernel, hashing one block per lane. */
+typedef void (*Md5Kernel)(Block *blocks[], byte hash[][HASH_SIZE]);
+
+/**
+ * Returns word j of a padded block, reading its bytes in little-endian order the
+ * same way md5HashPadded() builds its M array.
+ * @param block the padded block
+ * @param j index of the word, between 0 and 15
+ * @return the message word
+ */
+static inline word blockWord(Block const *block, int j)
+{
+    byte const *p = block->data + j * 4;
+    return (word) p[0] | ((word) p[1] << 8) | ((word) p[2] << 16) | ((word) p[3] << 24);
+}
+
+/** The initial MD5 state, for adding back in once the steps are done. */
+static word const initial[4] = { MD5_INITIAL_A, MD5_INITIAL_B, MD5_INITIAL_C, MD5_INITIAL_D };
+
+/**
+ * Adds the initial state back into one lane's final A, B, C, D and stores them
+ * as a 16-byte hash, low byte first.
+ * @param state the A, B, C, D words for one lane
+ * @param hash array the hash is stored in
+ */
+static inline void storeHash(word const state[4], byte hash[HASH_SIZE])
+{
+    for (int i = 0; i < 4; i++) {
+        word v = state[i] + initial[i];
+        hash[i * 4] = v & 0xFF;
+        hash[i * 4 + 1] = (v >> 8) & 0xFF;
+        hash[i * 4 + 2] = (v >> 16) & 0xFF;
+        hash[i * 4 + 3] = (v >> 24) & 0xFF;
+    }
+}
+
+#ifdef MD5_X86
+
+// The four F functions, for 4 lanes of 32-bit words.
+#define SSE2_F0( b, c, d ) _mm_or_si128( _mm_and_si128( b, c ), _mm_andnot_si128( b, d ) )
+#define SSE2_F1( b, c, d ) _mm_or_si128( _mm_and_si128( b, d ), _mm_andnot_si128( d, c ) )
+#define SSE2_F2( b, c, d ) _mm_xor_si128( _mm_xor_si128( b, c ), d )
+#define SSE2_F3( b, c, d ) _mm_xor_si128( c, _mm_or_si128( b, _mm_xor_si128( d, ones ) ) )
+
+/** One MD5 step across 4 lanes, the same as md5Iteration() without the register shuffle. */
+#define SSE2_STEP( f, a, b, c, d, g, s, k ) \
+    a = _mm_add_epi32( a, _mm_add_epi32( SSE2_F##f( b, c, d ), \
+                                         _mm_add_epi32( M[ g ], _mm_set1_epi32( (int) ( k ) ) ) ) ); \
+    a = _mm_add_epi32( _mm_or_si128( _mm_slli_epi32( a, s ), _mm_srli_epi32( a, 32 - ( s ) ) ), b );
+
+/**
+ * Hashes 4 padded blocks using SSE2.
+ * @param blocks the 4 blocks to hash
+ * @param hash array the 4 hashes are stored in
+ */
+__attribute__(( target( "sse2" ) ))
+static void md5Sse2(Block *blocks[], byte hash[][HASH_SIZE])
+{
+    __m128i M[BLOCK_WORDS];
+    for (size_t j = 0; j < BLOCK_WORDS; j++) {
+        M[j] = _mm_set_epi32(blockWord(blocks[3], j), blockWord(blocks[2], j),
+                             blockWord(blocks[1], j), blockWord(blocks[0], j));
+    }
+
+    __m128i ones = _mm_set1_epi32(-1);
+    __m128i A = _mm_set1_epi32((int) MD5_INITIAL_A);
+    __m128i B = _mm_set1_epi32((int) MD5_INITIAL_B);
+    __m128i C = _mm_set1_epi32((int) MD5_INITIAL_C);
+    __m128i D = _mm_set1_epi32((int) MD5_INITIAL_D);
+
+    MD5_STEPS( SSE2_STEP )
+
+    word out[4][4];
+    _mm_storeu_si128((__m128i *) out[0], A);
+    _mm_storeu_si128((__m128i *) out[1], B);
+    _mm_storeu_si128((__m128i *) out[2], C);
+    _mm_storeu_si128((__m128i *) out[3], D);
+    for (int lane = 0; lane < 4; lane++) {
+        word state[4] = { out[0][lane], out[1][lane], out[2][lane], out[3][lane] };
+        storeHash(state, hash[lane]);
+    }
+}
+
+// The four F functions, for 8 lanes of 32-bit words.
+#define AVX2_F0( b, c, d ) _mm256_or_si256( _mm256_and_si256( b, c ), _mm256_andnot_si256( b, d ) )
+#define AVX2_F1( b, c, d ) _mm256_or_si256( _mm256_and_si256( b, d ), _mm256_andnot_si256( d, c ) )
+#define AVX2_F2( b, c, d ) _mm256_xor_si256( _mm256_xor_si256( b, c ), d )
+#define AVX2_F3( b, c, d ) _mm256_xor_si256( c, _mm256_or_si256( b, _mm256_xor_si256( d, ones ) ) )
+
+/** One MD5 step across 8 lanes. */
+#define AVX2_STEP( f, a, b, c, d, g, s, k ) \
+    a = _mm256_add_epi32( a, _mm256_add_epi32( AVX2_F##f( b, c, d ), \
+                                               _mm256_add_epi32( M[ g ], _mm256_set1_epi32( (int) ( k ) ) ) ) ); \
+    a = _mm256_add_epi32( _mm256_or_si256( _mm256_slli_epi32( a, s ), _mm256_srli_epi32( a, 32 - ( s ) ) ), b );
+
+/**
+ * Hashes 8 padded blocks using AVX2.
+ * @param blocks the 8 blocks to hash
+ * @param hash array the 8 hashes are stored in
+ */
+__attribute__(( target( "avx2" ) ))
+static void md5Avx2(Block *blocks[], byte hash[][HASH_SIZE])
+{
+    __m256i M[BLOCK_WORDS];
+    for (size_t j = 0; j < BLOCK_WORDS; j++) {
+        M[j] = _mm256_set_epi32(blockWord(blocks[7], j), blockWord(blocks[6], j),
+                                blockWord(blocks[5], j), blockWord(blocks[4], j),
+                                blockWord(blocks[3], j), blockWord(blocks[2], j),
+                                blockWord(blocks[1], j), blockWord(blocks[0], j));
+    }
+
+    __m256i ones = _mm256_set1_epi32(-1);
+    __m256i A = _mm256_set1_epi32((int) MD5_INITIAL_A);
+    __m256i B = _mm256_set1_epi32((int) MD5_INITIAL_B);
+    __m256i C = _mm256_set1_epi32((int) MD5_INITIAL_C);
+    __m256i D = _mm256_set1_epi32((int) MD5_INITIAL_D);
+
+    MD5_STEPS( AVX2_STEP )
+
+    word out[4][8];
+    _mm256_storeu_si256((__m256i *) out[0], A);
+    _mm256_storeu_si256((__m256i *) out[1], B);
+    _mm256_storeu_si256((__m256i *) out[2], C);
+    _mm256_storeu_si256((__m256i *) out[3], D);
+    for (int lane = 0; lane < 8; lane++) {
+        word state[4] = { out[0][lane], out[1][lane], out[2][lane], out[3][lane] };
+        storeHash(state, hash[lane]);
+    }
+}
+
+// The four F functions for 16 lanes, each a single vpternlogd. The immediate is
+// the truth table of the function over its three inputs.
+#define AVX512_F0( b, c, d ) _mm512_ternarylogic_epi32( b, c, d, 0xCA )
+#define AVX512_F1( b, c, d ) _mm512_ternarylogic_epi32( b, c, d, 0xE4 )
+#define AVX512_F2( b, c, d ) _mm512_ternarylogic_epi32( b, c, d, 0x96 )
+#define AVX512_F3( b, c, d ) _mm512_ternarylogic_epi32( b, c, d, 0x39 )
+
+/** One MD5 step across 16 lanes, using vprold for the rotate. */
+#define AVX512_STEP( f, a, b, c, d, g, s, k ) \
+    a = _mm512_add_epi32( a, _mm512_add_epi32( AVX512_F##f( b, c, d ), \
+                                               _mm512_add_epi32( M[ g ], _mm512_set1_epi32( (int) ( k ) ) ) ) ); \
+    a = _mm512_add_epi32( _mm512_rol_epi32( a, s ), b );
+
+/**
+ * Hashes 16 padded blocks using AVX-512.
+ * @param blocks the 16 blocks to hash
+ * @param hash array the 16 hashes are stored in
+ */
+__attribute__(( target( "avx512f" ) ))
+static void md5Avx512(Block *blocks[], byte hash[][HASH_SIZE])
+{
+    __m512i M[BLOCK_WORDS];
+    for (size_t j = 0; j < BLOCK_WORDS; j++) {
+        M[j] = _mm512_set_epi32(blockWord(blocks[15], j), blockWord(blocks[14], j),
+                                blockWord(blocks[13], j), blockWord(blocks[12], j),
+                                blockWord(blocks[11], j), blockWord(blocks[10], j),
+                                blockWord(blocks[9], j), blockWord(blocks[8], j),
+                                blockWord(blocks[7], j), blockWord(blocks[6], j),
+                                blockWord(blocks[5], j), blockWord(blocks[4], j),
+                                blockWord(blocks[3], j), blockWord(blocks[2], j),
+                                blockWord(blocks[1], j), blockWord(blocks[0], j));
+    }
+
+    __m512i A = _mm512_set1_epi32((int) MD5_INITIAL_A);
+    __m512i B = _mm512_set1_epi32((int) MD5_INITIAL_B);
+    __m512i C = _mm512_set1_epi32((int) MD5_INITIAL_C);
+    __m512i D = _mm512_set1_epi32((int) MD5_INITIAL_D);
+
+    MD5_STEPS( AVX512_STEP )
+
+    word out[4][16];
+    _mm512_storeu_si512(out[0], A);
+    _mm512_storeu_si512(out[1], B);
+    _mm512_storeu_si512(out[2], C);
+    _mm512_storeu_si512(out[3], D);
+    for (int lane = 0; lane < 16; lane++) {
+        word state[4] = { out[0][lane], out[1][lane], out[2][lane], out[3][lane] };
+        storeHash(state, hash[lane]);
+    }
+}
+
+#endif
+
+/** Description of one of the kernels md5HashBatch() can use. */
+typedef struct {
+    /** Name used to pick this kernel with md5SelectKernel(). */
+    char const *name;
+
+    /** Number of blocks hashed per call. */
+    int lanes;
+
+    /** The kernel itself, or NULL for the scalar md5HashPadded() path. */
+    Md5Kernel fn;
+
+    /** CPU feature __builtin_cpu_supports() must report, or NULL if none is needed. */
+    char const *feature;
+} KernelInfo;
+
+/** All the kernels, from narrowest to widest. */
+static KernelInfo const kernels[] = {
+    { "scalar", 1, NULL, NULL },
+#ifdef MD5_X86
+    { "sse2", 4, md5Sse2, "sse2" },
+    { "avx2", 8, md5Avx2, "avx2" },
+    { "avx512", 16, md5Avx512, "avx512f" },
+#endif
+};
+
+/** Number of entries in the kernels array. */
+#define KERNEL_COUNT ( (int) ( sizeof( kernels ) / sizeof( kernels[ 0 ] ) ) )
+
+/** Kernel md5HashBatch() uses, or NULL if none has been selected yet. */
+static KernelInfo const *current = NULL;
+
+/**
+ * Reports whether the CPU we're running on can use the given kernel.
+ * @param info the kernel to check
+ * @return true if the kernel can run here
+ */
+static bool kernelSupported(KernelInfo const *info)
+{
+    if (info->feature == NULL) {
+        return true;
+    }
+#ifdef MD5_X86
+    __builtin_cpu_init();
+    // __builtin_cpu_supports() needs a string literal, so check each feature by name.
+    if (strcmp(info->feature, "sse2") == 0) {
+        return __builtin_cpu_supports("sse2");
+    }
+    if (strcmp(info->feature, "avx2") == 0) {
+        return __builtin_cpu_supports("avx2");
+    }
+    if (strcmp(info->feature, "avx512f") == 0) {
+        return __builtin_cpu_supports("avx512f");
+    }
+#endif
+    return false;
+}
+
+/**
+ * Chooses the kernel md5HashBatch() will use. Given NULL or "auto", this picks the
+ * widest kernel the CPU supports; otherwise it picks the kernel with the given name
+ * ("scalar", "sse2", "avx2" or "avx512"). This should be called once at startup,
+ * before any threads start hashing.
+ * @param name the kernel to use, or NULL for the fastest one available
+ * @return false if there's no such kernel or this CPU can't run it
+ */
+bool md5SelectKernel(char const *name)
+{
+    if (name == NULL || strcmp(name, "auto") == 0) {
+        for (int i = KERNEL_COUNT - 1; i >= 0; i--) {
+            if (kernelSupported(&kernels[i])) {
+                current = &kernels[i];
+                return true;
+            }
+        }
+        return false;
+    }
+
+    for (int i = 0; i < KERNEL_COUNT; i++) {
+        if (strcmp(kernels[i].name, name) == 0) {
+            if (!kernelSupported(&kernels[i])) {
+                return false;
+            }
+            current = &kernels[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Returns the name of the kernel md5HashBatch() is using.
+ * @return the kernel name
+ */
+char const *md5KernelName()
+{
+    if (current == NULL) {
+        md5SelectKernel(NULL);
+    }
+    return current->name;
+}
+
+/**
+ * Hashes n independent blocks that have already been padded, running as many as
+ * possible through the vector kernel at once. If the blocks don't fill the last set
+ * of lanes, the spare lanes repeat the last block and their hashes are thrown away.
+ * @param blocks the padded blocks to hash
+ * @param n number of blocks
+ * @param hash array the hash of each block is stored in
+ */
+void md5HashBatch(Block *blocks[], int n, byte hash[][HASH_SIZE])
+{
+    if (current == NULL) {
+        md5SelectKernel(NULL);
+    }
+    Md5Kernel kernel = current->fn;
+    int kernelLanes = current->lanes;
+
+    int i = 0;
+    if (kernel) {
+        for (; i + kernelLanes <= n; i += kernelLanes) {
+            kernel(blocks + i, hash + i);
+        }
+
+        if (n - i > 1) {
+            Block *tail[MD5_MAX_LANES];
+            byte tailHash[MD5_MAX_LANES][HASH_SIZE];
+            for (int lane = 0; lane < kernelLanes; lane++) {
+                tail[lane] = blocks[i + lane < n ? i + lane : n - 1];
+            }
+            kernel(tail, tailHash);
+            for (; i < n; i++) {
+                for (int j = 0; j < HASH_SIZE; j++) {
+                    hash[i][j] = tailHash[i % kernelLanes][j];
+                }
+            }
+        }
+    }
+
+    for (; i < n; i++) {
+        md5HashPadded(blocks[i], hash[i]);
+    }
+}
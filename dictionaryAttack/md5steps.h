@@ -0,0 +1,87 @@
+/**
+ * @file md5steps.h
+ * @author Sean Leana (smleana)
+ * The 64 steps of the MD5 compression function, written out as a list so each
+ * md5 kernel can expand them with its own STEP() macro. Each entry gives the round
+ * (which F function to use), the state words in the roles A, B, C, D for that step,
+ * the message word index, the rotate amount and the noise constant. These match
+ * md5Shift, md5Noise and the G functions in md5.c.
+ */
+
+#ifndef _MD5STEPS_H_
+#define _MD5STEPS_H_
+
+/** Initial values of the four MD5 state words, the same as md5Initial. */
+#define MD5_INITIAL_A 0x67452301U
+#define MD5_INITIAL_B 0xefcdab89U
+#define MD5_INITIAL_C 0x98badcfeU
+#define MD5_INITIAL_D 0x10325476U
+
+/** Expands STEP( round, a, b, c, d, g, s, k ) once for each of the 64 MD5 steps. */
+#define MD5_STEPS( STEP ) \
+    STEP( 0, A, B, C, D,  0,  7, 0xd76aa478U ) \
+    STEP( 0, D, A, B, C,  1, 12, 0xe8c7b756U ) \
+    STEP( 0, C, D, A, B,  2, 17, 0x242070dbU ) \
+    STEP( 0, B, C, D, A,  3, 22, 0xc1bdceeeU ) \
+    STEP( 0, A, B, C, D,  4,  7, 0xf57c0fafU ) \
+    STEP( 0, D, A, B, C,  5, 12, 0x4787c62aU ) \
+    STEP( 0, C, D, A, B,  6, 17, 0xa8304613U ) \
+    STEP( 0, B, C, D, A,  7, 22, 0xfd469501U ) \
+    STEP( 0, A, B, C, D,  8,  7, 0x698098d8U ) \
+    STEP( 0, D, A, B, C,  9, 12, 0x8b44f7afU ) \
+    STEP( 0, C, D, A, B, 10, 17, 0xffff5bb1U ) \
+    STEP( 0, B, C, D, A, 11, 22, 0x895cd7beU ) \
+    STEP( 0, A, B, C, D, 12,  7, 0x6b901122U ) \
+    STEP( 0, D, A, B, C, 13, 12, 0xfd987193U ) \
+    STEP( 0, C, D, A, B, 14, 17, 0xa679438eU ) \
+    STEP( 0, B, C, D, A, 15, 22, 0x49b40821U ) \
+    STEP( 1, A, B, C, D,  1,  5, 0xf61e2562U ) \
+    STEP( 1, D, A, B, C,  6,  9, 0xc040b340U ) \
+    STEP( 1, C, D, A, B, 11, 14, 0x265e5a51U ) \
+    STEP( 1, B, C, D, A,  0, 20, 0xe9b6c7aaU ) \
+    STEP( 1, A, B, C, D,  5,  5, 0xd62f105dU ) \
+    STEP( 1, D, A, B, C, 10,  9, 0x02441453U ) \
+    STEP( 1, C, D, A, B, 15, 14, 0xd8a1e681U ) \
+    STEP( 1, B, C, D, A,  4, 20, 0xe7d3fbc8U ) \
+    STEP( 1, A, B, C, D,  9,  5, 0x21e1cde6U ) \
+    STEP( 1, D, A, B, C, 14,  9, 0xc33707d6U ) \
+    STEP( 1, C, D, A, B,  3, 14, 0xf4d50d87U ) \
+    STEP( 1, B, C, D, A,  8, 20, 0x455a14edU ) \
+    STEP( 1, A, B, C, D, 13,  5, 0xa9e3e905U ) \
+    STEP( 1, D, A, B, C,  2,  9, 0xfcefa3f8U ) \
+    STEP( 1, C, D, A, B,  7, 14, 0x676f02d9U ) \
+    STEP( 1, B, C, D, A, 12, 20, 0x8d2a4c8aU ) \
+    STEP( 2, A, B, C, D,  5,  4, 0xfffa3942U ) \
+    STEP( 2, D, A, B, C,  8, 11, 0x8771f681U ) \
+    STEP( 2, C, D, A, B, 11, 16, 0x6d9d6122U ) \
+    STEP( 2, B, C, D, A, 14, 23, 0xfde5380cU ) \
+    STEP( 2, A, B, C, D,  1,  4, 0xa4beea44U ) \
+    STEP( 2, D, A, B, C,  4, 11, 0x4bdecfa9U ) \
+    STEP( 2, C, D, A, B,  7, 16, 0xf6bb4b60U ) \
+    STEP( 2, B, C, D, A, 10, 23, 0xbebfbc70U ) \
+    STEP( 2, A, B, C, D, 13,  4, 0x289b7ec6U ) \
+    STEP( 2, D, A, B, C,  0, 11, 0xeaa127faU ) \
+    STEP( 2, C, D, A, B,  3, 16, 0xd4ef3085U ) \
+    STEP( 2, B, C, D, A,  6, 23, 0x04881d05U ) \
+    STEP( 2, A, B, C, D,  9,  4, 0xd9d4d039U ) \
+    STEP( 2, D, A, B, C, 12, 11, 0xe6db99e5U ) \
+    STEP( 2, C, D, A, B, 15, 16, 0x1fa27cf8U ) \
+    STEP( 2, B, C, D, A,  2, 23, 0xc4ac5665U ) \
+    STEP( 3, A, B, C, D,  0,  6, 0xf4292244U ) \
+    STEP( 3, D, A, B, C,  7, 10, 0x432aff97U ) \
+    STEP( 3, C, D, A, B, 14, 15, 0xab9423a7U ) \
+    STEP( 3, B, C, D, A,  5, 21, 0xfc93a039U ) \
+    STEP( 3, A, B, C, D, 12,  6, 0x655b59c3U ) \
+    STEP( 3, D, A, B, C,  3, 10, 0x8f0ccc92U ) \
+    STEP( 3, C, D, A, B, 10, 15, 0xffeff47dU ) \
+    STEP( 3, B, C, D, A,  1, 21, 0x85845dd1U ) \
+    STEP( 3, A, B, C, D,  8,  6, 0x6fa87e4fU ) \
+    STEP( 3, D, A, B, C, 15, 10, 0xfe2ce6e0U ) \
+    STEP( 3, C, D, A, B,  6, 15, 0xa3014314U ) \
+    STEP( 3, B, C, D, A, 13, 21, 0x4e0811a1U ) \
+    STEP( 3, A, B, C, D,  4,  6, 0xf7537e82U ) \
+    STEP( 3, D, A, B, C, 11, 10, 0xbd3af235U ) \
+    STEP( 3, C, D, A, B,  2, 15, 0x2ad7d2bbU ) \
+    STEP( 3, B, C, D, A,  9, 21, 0xeb86d391U )
+
+#endif
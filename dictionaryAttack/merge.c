@@ -0,0 +1,125 @@
+/**
+ * @file merge.c
+ * @author Sean Leana (smleana)
+ * This file merges the output of a sharded job. Since each shard's lines are in
+ * shadow file order, a line's user is the next one after the previous line's with
+ * that name, which keeps users that share a name apart.
+ */
+
+#include "merge.h"
+#include <stdlib.h>
+#include <string.h>
+
+/** What separates a name from its password. */
+#define SEPARATOR " : "
+
+/** Longest line that can be a valid result, with its newline and a null. */
+#define RESULT_LINE (USERNAME_LIMIT + 3 + PW_LIMIT + 2)
+
+/**
+ * Starts a merge.
+ * @param merge the merge to initialize
+ * @param targets the users from the shadow file
+ */
+void initMerge(ResultMerge *merge, TargetSet const *targets)
+{
+    merge->targets = targets;
+    merge->passwords = (char **) calloc(targets->userCount > 0 ? targets->userCount : 1,
+                                        sizeof(char *));
+}
+
+/**
+ * Finds the next user with a given name.
+ * @param targets the users
+ * @param name the name
+ * @param from index of the first user to look at
+ * @return the user's index, or -1 if there isn't one
+ */
+static int findUser(TargetSet const *targets, char const *name, int from)
+{
+    for (int u = from; u < targets->userCount; u++) {
+        if (strcmp(targets->users[u].name, name) == 0) {
+            return u;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Adds the passwords in one shard's output.
+ * @param merge the merge
+ * @param filename name of the shard's output file
+ * @param line where the number of a bad line is stored
+ * @return MERGE_OK, MERGE_UNREADABLE or MERGE_INVALID
+ */
+int mergeResults(ResultMerge *merge, char const *filename, int *line)
+{
+    *line = 0;
+    FILE *fp = fopen(filename, "r");
+    if (fp == NULL) {
+        return MERGE_UNREADABLE;
+    }
+
+    char text[RESULT_LINE];
+    int next = 0;
+    int status = MERGE_OK;
+    while (status == MERGE_OK && fgets(text, sizeof(text), fp) != NULL) {
+        ++*line;
+        size_t len = strlen(text);
+        if (len == 0 || text[len - 1] != '\n') {
+            status = MERGE_INVALID;
+            break;
+        }
+        text[len - 1] = '\0';
+
+        // Names can't have a colon, so the first separator is the one.
+        char *sep = strstr(text, SEPARATOR);
+        if (sep == NULL) {
+            status = MERGE_INVALID;
+            break;
+        }
+        *sep = '\0';
+        char const *password = sep + strlen(SEPARATOR);
+        int u = findUser(merge->targets, text, next);
+        if (u < 0 || strlen(password) > PW_LIMIT) {
+            status = MERGE_INVALID;
+            break;
+        }
+        if (merge->passwords[u] == NULL) {
+            size_t pwLen = strlen(password);
+            merge->passwords[u] = (char *) malloc(pwLen + 1);
+            memcpy(merge->passwords[u], password, pwLen + 1);
+        }
+        next = u + 1;
+    }
+    fclose(fp);
+    return status;
+}
+
+/**
+ * Writes the merged output.
+ * @param merge the merge
+ * @param out the stream to write to
+ */
+void writeMerged(ResultMerge const *merge, FILE *out)
+{
+    for (int u = 0; u < merge->targets->userCount; u++) {
+        if (merge->passwords[u] != NULL) {
+            fprintf(out, "%s%s%s\n", merge->targets->users[u].name, SEPARATOR,
+                    merge->passwords[u]);
+        }
+    }
+}
+
+/**
+ * Frees a merge.
+ * @param merge the merge
+ */
+void freeMerge(ResultMerge *merge)
+{
+    for (int u = 0; u < merge->targets->userCount; u++) {
+        free(merge->passwords[u]);
+    }
+    free(merge->passwords);
+    merge->passwords = NULL;
+}
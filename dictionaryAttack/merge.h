@@ -0,0 +1,47 @@
+/**
+ * @file merge.h
+ * @author Sean Leana (smleana)
+ * This file defines the merge of the output of a sharded job. Each shard writes the
+ * users it cracked as "name : password" lines, in shadow file order; merging puts
+ * every shard's lines back together in that order, as if one job had run them all.
+ */
+
+#ifndef _MERGE_H_
+#define _MERGE_H_
+
+#include "target.h"
+#include <stdbool.h>
+#include <stdio.h>
+
+/** Result of mergeResults() when the file was merged. */
+#define MERGE_OK 1
+
+/** Result of mergeResults() when the file can't be read; errno is set. */
+#define MERGE_UNREADABLE 0
+
+/** Result of mergeResults() when a line isn't a cracked user from the shadow file. */
+#define MERGE_INVALID -1
+
+/** The passwords found so far for the users of a shadow file. */
+typedef struct {
+    /** The users. */
+    TargetSet const *targets;
+
+    /** Password of each user, in shadow file order, or NULL if no shard found it. */
+    char **passwords;
+} ResultMerge;
+
+/** starts a merge with no passwords for the users in the given target set */
+void initMerge( ResultMerge *merge, TargetSet const *targets );
+
+/** adds the passwords in one shard's output file. Returns MERGE_OK, MERGE_UNREADABLE
+ * or MERGE_INVALID, with the number of the bad line stored in line. */
+int mergeResults( ResultMerge *merge, char const *filename, int *line );
+
+/** writes a line for every user with a password, in shadow file order */
+void writeMerged( ResultMerge const *merge, FILE *out );
+
+/** frees the passwords */
+void freeMerge( ResultMerge *merge );
+
+#endif
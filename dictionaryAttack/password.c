@@ -15,6 +15,36 @@
 /** Number of iterations of hashing to make a password. */
 #define PW_ITERATIONS 1000
 
+/** The block computeNextIntermediate() builds depends only on inum % 2, % 3 and % 7,
+    so its layout repeats every 42 rounds. */
+#define TEMPLATE_ROUNDS 42
+
+/** The padded blocks computeNextIntermediate() builds for one password and salt, one
+    for each round mod TEMPLATE_ROUNDS. Only the intermediate hash changes from one
+    round to the next, so it's patched in at its offset before each round is hashed. */
+typedef struct {
+    /** Padded block for each round, with the intermediate hash left blank. */
+    Block block[TEMPLATE_ROUNDS];
+
+    /** Where the intermediate hash goes in each block. */
+    int offset[TEMPLATE_ROUNDS];
+} ChainTemplate;
+
+/** Given a password and a salt string, this function fills in the block whose hash is
+ * the alternate hash used in the MD5 password encryption algorithm.
+ * @param block an empty block to fill
+ * @param pass the password to hash
+ * @param passLen length of the password
+ * @param salt a saltstring to help hash the function
+ */
+static void buildAlternateBlock(Block *block, char const pass[], int passLen,
+        char const salt[SALT_LENGTH + 1])
+{
+    appendBytes(block, pass, passLen);
+    appendString(block, salt);
+    appendBytes(block, pass, passLen);
+}
+
 /** Given a password and a salt string, this function computes the alternate hash used in the
  * MD5 password encryption algorithm and leaves it in the altHash array.
  * @param pass the password to hash
@@ -23,28 +53,25 @@
  */
 void computeAlternateHash(char const pass[], char const salt[SALT_LENGTH + 1], byte altHash[HASH_SIZE])
 {
-    Block *block = makeBlock();
-    appendString(block, pass);
-    appendString(block, salt);
-    appendString(block, pass);
+    Block block;
+    initBlock(&block);
+    buildAlternateBlock(&block, pass, strlen(pass), salt);
 
-    md5Hash(block, altHash);
+    md5Hash(&block, altHash);
 }
 
-/** Given a password, a salt string and an alternate hash, this function computes the first intermediate hash
- * used in the MD5 password encryption algorithm and leaves it in the intHash array.
+/** Given a password, a salt string and an alternate hash, this function fills in the block
+ * whose hash is the first intermediate hash.
+ * @param block an empty block to fill
  * @param pass the password to hash
+ * @param passLen length of the password
  * @param salt a salt string to help hash the password
  * @param altHash the alternate hash
- * @param intHash 
  */
-void computeFirstIntermediate(char const pass[], char const salt[SALT_LENGTH + 1], byte altHash[HASH_SIZE],
-        byte intHash[HASH_SIZE]) 
+static void buildFirstIntermediateBlock(Block *block, char const pass[], int passLen,
+        char const salt[SALT_LENGTH + 1], byte altHash[HASH_SIZE])
 {
-    Block *block = makeBlock();
-    int passLen = strlen(pass);
-
-    appendString(block, pass);
+    appendBytes(block, pass, passLen);
     appendString(block, "$1$");
     appendString(block, salt);
     for (int i = 0; i < passLen; i++) {
@@ -59,40 +86,93 @@ void computeFirstIntermediate(char const pass[], char const salt[SALT_LENGTH + 1
         }
         passLen >>= 1;
     }
-    md5Hash(block, intHash);
+}
+
+/** Given a password, a salt string and an alternate hash, this function computes the first intermediate hash
+ * used in the MD5 password encryption algorithm and leaves it in the intHash array.
+ * @param pass the password to hash
+ * @param salt a salt string to help hash the password
+ * @param altHash the alternate hash
+ * @param intHash 
+ */
+void computeFirstIntermediate(char const pass[], char const salt[SALT_LENGTH + 1], byte altHash[HASH_SIZE],
+        byte intHash[HASH_SIZE]) 
+{
+    Block block;
+    initBlock(&block);
+    buildFirstIntermediateBlock(&block, pass, strlen(pass), salt, altHash);
+    md5Hash(&block, intHash);
 }
 
 /**
- * Given a password, a salt string and the one of the intermediate hash values, this function computes the next
- * intermediate hash used in the MD5 password encryption algorithm. The previous alternate hash is given in the
- * intHash array, and the next alternate hash is stored in in this same array when this function returns. The
- * inum parameter is the iteration number for the algorithm, between 0 and 999.
+ * Given a password, a salt string, an iteration number and the previous intermediate hash,
+ * this function fills in the block whose hash is the next intermediate hash.
+ * @param block an empty block to fill
+ * @param pass the password to hash
+ * @param passLen length of the password
+ * @param salt a salt string to help hash the password
+ * @param inum the iteration number, between 0 and 999
+ * @param intHash the previous intermediate hash
  */
-void computeNextIntermediate(char const pass[], char const salt[SALT_LENGTH + 1], int inum, byte intHash[HASH_SIZE])
+static void buildNextIntermediateBlock(Block *block, char const pass[], int passLen,
+        char const salt[SALT_LENGTH + 1], int inum, byte intHash[HASH_SIZE])
 {
-    Block *block = makeBlock();
     if (inum % 2 == 0) {
         for (int i = 0; i < 16; i++) {
             appendByte(block, intHash[i]);
         }
     } else {
-        appendString(block, pass);
+        appendBytes(block, pass, passLen);
     }
     if (inum % 3 != 0) {
         appendString(block, salt);
     }
     if (inum % 7 != 0) {
-        appendString(block, pass);
+        appendBytes(block, pass, passLen);
     }
 
     if (inum % 2 == 0) {
-        appendString(block, pass);
+        appendBytes(block, pass, passLen);
     } else {
         for (int i = 0; i < 16; i++) {
             appendByte(block, intHash[i]);
         }
     }
-    md5Hash(block, intHash);
+}
+
+/**
+ * Builds the padded blocks for every round layout of computeNextIntermediate() for the
+ * given password and salt, recording where the intermediate hash goes in each one.
+ * @param chain the template to fill in
+ * @param pass the password to hash
+ * @param passLen length of the password
+ * @param salt a salt string to help hash the password
+ */
+static void buildChainTemplate(ChainTemplate *chain, char const pass[], int passLen,
+        char const salt[SALT_LENGTH + 1])
+{
+    byte blank[HASH_SIZE] = { 0 };
+    for (int r = 0; r < TEMPLATE_ROUNDS; r++) {
+        Block *block = &chain->block[r];
+        initBlock(block);
+        buildNextIntermediateBlock(block, pass, passLen, salt, r, blank);
+        chain->offset[r] = r % 2 == 0 ? 0 : block->len - HASH_SIZE;
+        padBlock(block);
+    }
+}
+
+/**
+ * Given a password, a salt string and the one of the intermediate hash values, this function computes the next
+ * intermediate hash used in the MD5 password encryption algorithm. The previous alternate hash is given in the
+ * intHash array, and the next alternate hash is stored in in this same array when this function returns. The
+ * inum parameter is the iteration number for the algorithm, between 0 and 999.
+ */
+void computeNextIntermediate(char const pass[], char const salt[SALT_LENGTH + 1], int inum, byte intHash[HASH_SIZE])
+{
+    Block block;
+    initBlock(&block);
+    buildNextIntermediateBlock(&block, pass, strlen(pass), salt, inum, intHash);
+    md5Hash(&block, intHash);
 }
 
 /** Given a 16-byte hash value, this function converts it to a string of
@@ -151,6 +231,42 @@ void hashToString(byte hash[HASH_SIZE], char result[PW_HASH_LIMIT + 1])
     for (int i = 0; i < PW_HASH_LIMIT; i++) {
         result[i] = pwCode64[sixBitHash[i]];
     }
+    result[PW_HASH_LIMIT] = '\0';
+}
+
+/** Given a hash string made by hashToString(), this function recovers the 16-byte hash
+ * value it encodes, using pwCode64 and pwPerm in reverse. This lets a target hash be
+ * decoded once and compared against raw hashes, rather than encoding every candidate.
+ * @param str the hash string, PW_HASH_LIMIT characters long
+ * @param hash the hash value it encodes
+ * @return false if the string isn't something hashToString() could have produced
+ */
+bool stringToHash(char const str[], byte hash[HASH_SIZE])
+{
+    byte sixBitHash[SIX_BYTE_HASH];
+    for (int i = 0; i < SIX_BYTE_HASH; i++) {
+        char const *pos = str[i] ? strchr(pwCode64, str[i]) : NULL;
+        if (pos == NULL) {
+            return false;
+        }
+        sixBitHash[i] = pos - pwCode64;
+    }
+    if (str[SIX_BYTE_HASH] != '\0' || sixBitHash[SIX_BYTE_HASH - 1] > 0x03) {
+        return false;
+    }
+
+    byte permutedHash[HASH_SIZE];
+    for (int i = 0, j = 0; i < HASH_SIZE - 1; i += 3, j += 4) {
+        permutedHash[i] = sixBitHash[j] | ((sixBitHash[j + 1] & 0x03) << 6);
+        permutedHash[i + 1] = (sixBitHash[j + 1] >> 2) | ((sixBitHash[j + 2] & 0x0F) << 4);
+        permutedHash[i + 2] = (sixBitHash[j + 2] >> 4) | (sixBitHash[j + 3] << 2);
+    }
+    permutedHash[HASH_SIZE - 1] = sixBitHash[SIX_BYTE_HASH - 2] | (sixBitHash[SIX_BYTE_HASH - 1] << 6);
+
+    for (int i = 0; i < HASH_SIZE; i++) {
+        hash[pwPerm[i]] = permutedHash[i];
+    }
+    return true;
 }
 
 /**
@@ -173,4 +289,80 @@ void hashPassword(char const pass[], char const salt[SALT_LENGTH + 1], char resu
     }
 
     hashToString(intHash, result);
-}
\ No newline at end of file
+}
+
+/**
+ * Hashes n passwords, each with its own salt, advancing all of their hash chains in
+ * lock-step so every md5 step can fill the vector lanes of md5HashBatch(). The raw
+ * 16-byte hash for pass[ i ] and salt[ i ] is stored in hash[ i ]; it's the value
+ * hashPassword() would pass to hashToString().
+ * @param pass the passwords to hash
+ * @param salt the salt to use with each password
+ * @param n number of passwords
+ * @param hash array the hash values are stored in
+ */
+void hashPasswordBatchRaw(char const *pass[], char const *salt[], int n, byte hash[][HASH_SIZE])
+{
+    Block blocks[MD5_MAX_LANES];
+    ChainTemplate chain[MD5_MAX_LANES];
+    Block *lane[MD5_MAX_LANES];
+    byte altHash[MD5_MAX_LANES][HASH_SIZE];
+    byte intHash[MD5_MAX_LANES][HASH_SIZE];
+    int len[MD5_MAX_LANES];
+
+    for (int first = 0; first < n; first += MD5_MAX_LANES) {
+        int count = n - first < MD5_MAX_LANES ? n - first : MD5_MAX_LANES;
+        char const **p = pass + first;
+        char const **s = salt + first;
+
+        // Measure each password once, rather than every time it goes in a block.
+        for (int i = 0; i < count; i++) {
+            len[i] = strlen(p[i]);
+            lane[i] = &blocks[i];
+            initBlock(&blocks[i]);
+            buildAlternateBlock(&blocks[i], p[i], len[i], s[i]);
+            padBlock(&blocks[i]);
+        }
+        md5HashBatch(lane, count, altHash);
+
+        for (int i = 0; i < count; i++) {
+            initBlock(&blocks[i]);
+            buildFirstIntermediateBlock(&blocks[i], p[i], len[i], s[i], altHash[i]);
+            padBlock(&blocks[i]);
+            buildChainTemplate(&chain[i], p[i], len[i], s[i]);
+        }
+        md5HashBatch(lane, count, intHash);
+
+        for (int inum = 0; inum < PW_ITERATIONS; inum++) {
+            int r = inum % TEMPLATE_ROUNDS;
+            for (int i = 0; i < count; i++) {
+                lane[i] = &chain[i].block[r];
+                memcpy(lane[i]->data + chain[i].offset[r], intHash[i], HASH_SIZE);
+            }
+            md5HashBatch(lane, count, intHash);
+        }
+
+        memcpy(hash + first, intHash, count * HASH_SIZE);
+    }
+}
+
+/**
+ * Hashes n passwords, each with its own salt, with hashPasswordBatchRaw(), and
+ * stores the hash string for pass[ i ] and salt[ i ] in result[ i ], exactly as
+ * hashPassword() would compute it.
+ * @param pass the passwords to hash
+ * @param salt the salt to use with each password
+ * @param n number of passwords
+ * @param result array the hash strings are stored in
+ */
+void hashPasswordBatch(char const *pass[], char const *salt[], int n, char result[][PW_HASH_LIMIT + 1])
+{
+    byte hash[MD5_MAX_LANES][HASH_SIZE];
+    for (int first = 0; first < n; first += MD5_MAX_LANES) {
+        int count = n - first < MD5_MAX_LANES ? n - first : MD5_MAX_LANES;
+        hashPasswordBatchRaw(pass + first, salt + first, count, hash);
+        for (int i = 0; i < count; i++) {
+            hashToString(hash[i], result[first + i]);
+        }
+    }
+}
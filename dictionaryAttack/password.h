@@ -6,6 +6,9 @@
 #ifndef _PASSWORD_H_
 #define _PASSWORD_H_
 
+#include "md5.h"
+#include <stdbool.h>
+
 /** Required length of the salt string. */
 #define SALT_LENGTH 8
 
@@ -26,5 +29,31 @@
  */
 void hashPassword( char const pass[], char const salt[ SALT_LENGTH + 1 ], char result[ PW_HASH_LIMIT + 1 ] );
 
+/** hashes n passwords at once, each with its own salt, running their hash chains in
+ * lock-step across the md5 vector lanes. Gives the same results as calling
+ * hashPassword() on each pass[ i ], salt[ i ] pair.
+ * @param pass passwords to hash, each at most PW_LIMIT characters
+ * @param salt salt to use with each password
+ * @param n number of passwords
+ * @param result result hash string for each password
+ */
+void hashPasswordBatch( char const *pass[], char const *salt[], int n, char result[][ PW_HASH_LIMIT + 1 ] );
+
+
+/** hashes n passwords at once like hashPasswordBatch(), but leaves each result as the
+ * raw 16-byte hash value rather than encoding it as a string
+ * @param pass passwords to hash, each at most PW_LIMIT characters
+ * @param salt salt to use with each password
+ * @param n number of passwords
+ * @param hash raw hash value for each password
+ */
+void hashPasswordBatchRaw( char const *pass[], char const *salt[], int n, byte hash[][ HASH_SIZE ] );
+
+/** encodes a raw hash value as a hash string, the way hashPassword() reports it */
+void hashToString( byte hash[ HASH_SIZE ], char result[ PW_HASH_LIMIT + 1 ] );
+
+/** decodes a hash string back into the raw hash value it encodes, the reverse of
+ * hashToString(). Returns false if the string isn't a valid hash string. */
+bool stringToHash( char const str[], byte hash[ HASH_SIZE ] );
 
 #endif
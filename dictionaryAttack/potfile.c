@@ -0,0 +1,269 @@
+/**
+ * @file potfile.c
+ * @author Sean Leana (smleana)
+ * This file keeps the potfile. Its entries are held in an open-addressing table keyed
+ * by salt and decoded hash, with the passwords packed into one arena, and new entries
+ * are appended to the end of the file, so an entry that made it to the file is never
+ * rewritten or lost.
+ */
+
+#include "potfile.h"
+#include <stdlib.h>
+#include <string.h>
+
+/** Initial number of slots in the table. */
+#define INITIAL_SLOTS 64
+
+/** Initial size of the arena. */
+#define INITIAL_ARENA 4096
+
+/** What comes before the salt in an entry. */
+#define MD5_PREFIX "$1$"
+
+/** Length of an entry up to the colon before its password. */
+#define KEY_LENGTH (3 + SALT_LENGTH + 1 + PW_HASH_LIMIT)
+
+/** Longest line that can be a valid entry, with its newline and a null. */
+#define LINE_LIMIT (KEY_LENGTH + 1 + PW_LIMIT + 2)
+
+/**
+ * Hashes a salt and hash value for the table (FNV-1a).
+ * @param salt the salt
+ * @param hash the decoded hash
+ * @return the hash of the pair
+ */
+static word potHash(char const salt[SALT_LENGTH + 1], byte const hash[HASH_SIZE])
+{
+    word h = 2166136261U;
+    for (int i = 0; i < SALT_LENGTH; i++) {
+        h = (h ^ (byte) salt[i]) * 16777619U;
+    }
+    for (int i = 0; i < HASH_SIZE; i++) {
+        h = (h ^ hash[i]) * 16777619U;
+    }
+    return h;
+}
+
+/**
+ * Finds the slot for a salt and hash value: the one holding them, or the empty slot
+ * where they'd go.
+ * @param pot the potfile
+ * @param salt the salt
+ * @param hash the decoded hash
+ * @return the slot
+ */
+static PotSlot *findSlot(Potfile const *pot, char const salt[SALT_LENGTH + 1],
+                         byte const hash[HASH_SIZE])
+{
+    int mask = pot->capacity - 1;
+    int i = potHash(salt, hash) & mask;
+    while (pot->slots[i].password != 0
+           && (memcmp(pot->slots[i].hash, hash, HASH_SIZE) != 0
+               || strcmp(pot->slots[i].salt, salt) != 0)) {
+        i = (i + 1) & mask;
+    }
+    return &pot->slots[i];
+}
+
+/**
+ * Doubles the size of the table.
+ * @param pot the potfile
+ */
+static void growSlots(Potfile *pot)
+{
+    PotSlot *old = pot->slots;
+    int oldCapacity = pot->capacity;
+    pot->capacity *= 2;
+    pot->slots = (PotSlot *) calloc(pot->capacity, sizeof(PotSlot));
+    for (int i = 0; i < oldCapacity; i++) {
+        if (old[i].password != 0) {
+            *findSlot(pot, old[i].salt, old[i].hash) = old[i];
+        }
+    }
+    free(old);
+}
+
+/**
+ * Adds an entry to the table, unless its salt and hash are already there.
+ * @param pot the potfile
+ * @param salt the salt
+ * @param hash the decoded hash
+ * @param password the password
+ * @return true if the entry was added
+ */
+static bool insertEntry(Potfile *pot, char const salt[SALT_LENGTH + 1],
+                        byte const hash[HASH_SIZE], char const *password)
+{
+    // Keep the table at most half full.
+    if ((pot->count + 1) * 2 > pot->capacity) {
+        growSlots(pot);
+    }
+    PotSlot *slot = findSlot(pot, salt, hash);
+    if (slot->password != 0) {
+        return false;
+    }
+
+    size_t len = strlen(password);
+    while (pot->arenaSize + len + 1 > pot->arenaCapacity) {
+        pot->arenaCapacity *= 2;
+        pot->arena = (char *) realloc(pot->arena, pot->arenaCapacity);
+    }
+    memcpy(pot->arena + pot->arenaSize, password, len + 1);
+    memcpy(slot->salt, salt, SALT_LENGTH + 1);
+    memcpy(slot->hash, hash, HASH_SIZE);
+    slot->password = pot->arenaSize + 1;
+    pot->arenaSize += len + 1;
+    pot->count++;
+    return true;
+}
+
+/**
+ * Initializes an empty table, with no file.
+ * @param pot the potfile to initialize
+ */
+void initPotfile(Potfile *pot)
+{
+    memset(pot, 0, sizeof(Potfile));
+    pot->capacity = INITIAL_SLOTS;
+    pot->slots = (PotSlot *) calloc(pot->capacity, sizeof(PotSlot));
+    pot->arenaCapacity = INITIAL_ARENA;
+    pot->arena = (char *) malloc(pot->arenaCapacity);
+}
+
+/**
+ * Checks one line of a potfile and adds it to the table if it's a valid entry.
+ * @param pot the potfile
+ * @param line the line, without its newline
+ * @return true if the line is a valid entry
+ */
+bool loadPotEntry(Potfile *pot, char *line)
+{
+    size_t len = strlen(line);
+    if (len < KEY_LENGTH + 1 || len > KEY_LENGTH + 1 + PW_LIMIT
+            || strncmp(line, MD5_PREFIX, strlen(MD5_PREFIX)) != 0
+            || line[3 + SALT_LENGTH] != '$' || line[KEY_LENGTH] != ':'
+            || memchr(line + 3, '$', SALT_LENGTH) != NULL) {
+        return false;
+    }
+
+    char salt[SALT_LENGTH + 1];
+    memcpy(salt, line + 3, SALT_LENGTH);
+    salt[SALT_LENGTH] = '\0';
+    line[KEY_LENGTH] = '\0';
+    byte hash[HASH_SIZE];
+    if (!stringToHash(line + 3 + SALT_LENGTH + 1, hash)) {
+        return false;
+    }
+    insertEntry(pot, salt, hash, line + KEY_LENGTH + 1);
+    return true;
+}
+
+/**
+ * Loads a potfile and opens it for appending.
+ * @param pot the potfile to fill in
+ * @param filename name of the file
+ * @return false if the file couldn't be read or created, with errno set
+ */
+bool openPotfile(Potfile *pot, char const *filename)
+{
+    initPotfile(pot);
+    pot->out = fopen(filename, "a+");
+    if (pot->out == NULL) {
+        closePotfile(pot);
+        return false;
+    }
+
+    // Read from the start; appends still go to the end whatever the position.
+    rewind(pot->out);
+    char line[LINE_LIMIT];
+    bool whole = true;
+    while (fgets(line, sizeof(line), pot->out) != NULL) {
+        size_t len = strlen(line);
+        bool ends = len > 0 && line[len - 1] == '\n';
+        if (ends) {
+            line[--len] = '\0';
+        }
+        // Only the start of a line can be an entry, and only if it fit.
+        if (whole && ends) {
+            loadPotEntry(pot, line);
+        }
+        whole = ends;
+    }
+
+    // A last line cut short is skipped, and new entries start on a line of their own.
+    if (!whole) {
+        fputc('\n', pot->out);
+    }
+    return true;
+}
+
+/**
+ * Looks up a salt and hash value.
+ * @param pot the potfile
+ * @param salt the salt
+ * @param hash the decoded hash
+ * @return the password, or NULL if the potfile doesn't have it
+ */
+char const *findPot(Potfile const *pot, char const salt[SALT_LENGTH + 1],
+                    byte const hash[HASH_SIZE])
+{
+    PotSlot const *slot = findSlot(pot, salt, hash);
+    return slot->password != 0 ? pot->arena + slot->password - 1 : NULL;
+}
+
+/**
+ * Records a newly cracked password, in the table and at the end of the file.
+ * @param pot the potfile
+ * @param salt the salt
+ * @param hash the decoded hash
+ * @param password the password
+ */
+void addPot(Potfile *pot, char const salt[SALT_LENGTH + 1], byte const hash[HASH_SIZE],
+            char const *password)
+{
+    if (insertEntry(pot, salt, hash, password) && pot->out != NULL) {
+        writePotEntry(pot->out, salt, hash, password);
+    }
+}
+
+/**
+ * Writes one entry, in the potfile's format.
+ * @param fp the file to write to
+ * @param salt the salt
+ * @param hash the decoded hash
+ * @param password the password
+ */
+void writePotEntry(FILE *fp, char const salt[SALT_LENGTH + 1], byte const hash[HASH_SIZE],
+                   char const *password)
+{
+    char str[PW_HASH_LIMIT + 1];
+    hashToString((byte *) hash, str);
+    fprintf(fp, "%s%s$%s:%s\n", MD5_PREFIX, salt, str, password);
+}
+
+/**
+ * Writes out the entries appended so far.
+ * @param pot the potfile
+ */
+void flushPot(Potfile *pot)
+{
+    if (pot->out != NULL) {
+        fflush(pot->out);
+    }
+}
+
+/**
+ * Closes a potfile.
+ * @param pot the potfile
+ */
+void closePotfile(Potfile *pot)
+{
+    if (pot->out != NULL) {
+        fclose(pot->out);
+    }
+    free(pot->slots);
+    free(pot->arena);
+    pot->out = NULL;
+    pot->slots = NULL;
+    pot->arena = NULL;
+}
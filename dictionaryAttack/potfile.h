@@ -0,0 +1,81 @@
+/**
+ * @file potfile.h
+ * @author Sean Leana (smleana)
+ * This file defines the potfile, which remembers every password ever cracked from one
+ * run to the next. Each line of the file is a salt and hash, as they appear in the
+ * shadow file, and the password that goes with them:
+ *
+ *   $1$salt1234$MPPZJeod4Sk89awLhwv591:password
+ *
+ * The file is only ever appended to. When it's opened, its entries are loaded into a
+ * hash table, so a shadow entry cracked on an earlier run is answered without hashing
+ * anything at all.
+ */
+
+#ifndef _POTFILE_H_
+#define _POTFILE_H_
+
+#include "password.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+/** One slot of the potfile's open-addressing table. */
+typedef struct {
+    /** The salt and decoded hash of the entry in this slot. */
+    char salt[ SALT_LENGTH + 1 ];
+    byte hash[ HASH_SIZE ];
+
+    /** One more than the offset of the password in the arena, or 0 for an empty slot. */
+    size_t password;
+} PotSlot;
+
+/** An open potfile and the table of its entries. */
+typedef struct {
+    /** Table of entries, indexed by a hash of the salt and hash value. */
+    PotSlot *slots;
+    int capacity;
+    int count;
+
+    /** Every password in the table, each followed by a null. */
+    char *arena;
+    size_t arenaSize;
+    size_t arenaCapacity;
+
+    /** The file, open for appending, or NULL for a table that's only in memory. */
+    FILE *out;
+} Potfile;
+
+/** initializes an empty table of entries with no file behind it */
+void initPotfile( Potfile *pot );
+
+/** loads the entries of the given potfile, which doesn't need to exist yet, and opens
+ * it for appending. Lines that aren't valid entries, like one cut short by a crash,
+ * are skipped. Returns false, with errno set, if the file can't be read or created. */
+bool openPotfile( Potfile *pot, char const *filename );
+
+/** adds the entry on the given line, without its newline, to the table, unless it's
+ * already there. Returns false if the line isn't a valid entry. */
+bool loadPotEntry( Potfile *pot, char *line );
+
+/** returns the password for the given salt and decoded hash, or NULL if it isn't in
+ * the potfile */
+char const *findPot( Potfile const *pot, char const salt[ SALT_LENGTH + 1 ],
+                     byte const hash[ HASH_SIZE ] );
+
+/** adds a newly cracked password to the table and appends it to the file, if there
+ * is one, unless it's already there */
+void addPot( Potfile *pot, char const salt[ SALT_LENGTH + 1 ], byte const hash[ HASH_SIZE ],
+             char const *password );
+
+/** writes out any entries appended since the last flush */
+void flushPot( Potfile *pot );
+
+/** writes one entry to the given file */
+void writePotEntry( FILE *fp, char const salt[ SALT_LENGTH + 1 ], byte const hash[ HASH_SIZE ],
+                    char const *password );
+
+/** closes the file, if there is one, and frees the table */
+void closePotfile( Potfile *pot );
+
+#endif
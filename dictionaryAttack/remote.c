@@ -0,0 +1,120 @@
+/**
+ * @file remote.c
+ * @author Sean Leana (smleana)
+ * This file talks to the coordinator for a worker. The connection blocks, since the
+ * worker has nothing else to do while it waits for an answer.
+ */
+
+#include "remote.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Starts talking to a coordinator.
+ * @param remote the connection to initialize
+ * @param fd the connected socket
+ * @param engine the engine hashing the leases
+ * @param targets the users the engine is cracking
+ */
+void openRemote(Remote *remote, int fd, Engine *engine, TargetSet const *targets)
+{
+    openConnection(&remote->conn, fd);
+    remote->engine = engine;
+    remote->targets = targets;
+    remote->told = (bool *) calloc(targets->digestCount + 1, sizeof(bool));
+    remote->reported = 0;
+    remote->timeout = 0;
+}
+
+/**
+ * Joins the job.
+ * @param remote the connection
+ * @param keyspace number of candidates in the job
+ * @param job description of the job
+ * @return REMOTE_JOINED, REMOTE_REJECTED or REMOTE_LOST
+ */
+int joinJob(Remote *remote, long long keyspace, char const *job)
+{
+    sendMessage(&remote->conn, "hello %d %lld %s\n", remote->targets->digestCount, keyspace,
+                job);
+    char *message;
+    if (!flushConnection(&remote->conn)
+            || receiveMessage(&remote->conn, &message) != CONNECTION_MESSAGE) {
+        return REMOTE_LOST;
+    }
+    int n = 0;
+    if (sscanf(message, "ok %d%n", &remote->timeout, &n) == 1 && message[n] == '\0'
+            && remote->timeout > 0) {
+        return REMOTE_JOINED;
+    }
+    return strncmp(message, "error ", 6) == 0 ? REMOTE_REJECTED : REMOTE_LOST;
+}
+
+/**
+ * Asks for a lease.
+ * @param remote the connection
+ * @param size largest number of candidates to ask for
+ * @param lease where the lease is stored
+ * @return REMOTE_RANGE, REMOTE_WAIT, REMOTE_DONE or REMOTE_LOST
+ */
+int requestLease(Remote *remote, long long size, Lease *lease)
+{
+    sendMessage(&remote->conn, "lease %lld\n", size);
+    if (!flushConnection(&remote->conn)) {
+        return REMOTE_LOST;
+    }
+
+    int digestCount = remote->targets->digestCount;
+    char *message;
+    while (receiveMessage(&remote->conn, &message) == CONNECTION_MESSAGE) {
+        int d;
+        int n = 0;
+        if (sscanf(message, "cracked %d%n", &d, &n) == 1 && message[n] == ' '
+                && d >= 0 && d < digestCount && strlen(message + n + 1) <= PW_LIMIT) {
+            remote->told[d] = true;
+            knownPassword(remote->engine, d, message + n + 1);
+        } else if (sscanf(message, "range %lld %lld %lld%n", &lease->id, &lease->start,
+                          &lease->end, &n) == 3 && message[n] == '\0') {
+            return REMOTE_RANGE;
+        } else if (strcmp(message, "wait") == 0) {
+            return REMOTE_WAIT;
+        } else if (strcmp(message, "done") == 0) {
+            return REMOTE_DONE;
+        } else {
+            return REMOTE_LOST;
+        }
+    }
+    return REMOTE_LOST;
+}
+
+/**
+ * Finishes a lease.
+ * @param remote the connection
+ * @param lease the lease
+ * @return false if the coordinator has gone
+ */
+bool returnLease(Remote *remote, Lease const *lease)
+{
+    char password[PW_LIMIT + 1];
+    int d;
+    while ((d = crackedPassword(remote->engine, remote->reported, password)) >= 0) {
+        if (!remote->told[d]) {
+            sendMessage(&remote->conn, "cracked %d %s\n", d, password);
+        }
+        remote->reported++;
+    }
+    sendMessage(&remote->conn, "finished %lld\n", lease->id);
+    return flushConnection(&remote->conn);
+}
+
+/**
+ * Closes the connection to the coordinator.
+ * @param remote the connection
+ */
+void closeRemote(Remote *remote)
+{
+    closeConnection(&remote->conn);
+    free(remote->told);
+    remote->told = NULL;
+}
@@ -0,0 +1,75 @@
+/**
+ * @file remote.h
+ * @author Sean Leana (smleana)
+ * This file defines a worker's side of a job spread out by a coordinator. The worker
+ * joins the job, then asks for one lease at a time, and hears about the passwords
+ * the other workers have cracked along with each one.
+ */
+
+#ifndef _REMOTE_H_
+#define _REMOTE_H_
+
+#include "connection.h"
+#include "engine.h"
+#include "lease.h"
+#include <stdbool.h>
+
+/** Result of joinJob() when the worker has joined. */
+#define REMOTE_JOINED 1
+
+/** Result of requestLease() when it got a lease. */
+#define REMOTE_RANGE 1
+
+/** Result of requestLease() when every candidate is leased for now. */
+#define REMOTE_WAIT 2
+
+/** Result of requestLease() when the job is done. */
+#define REMOTE_DONE 0
+
+/** Result of either when the coordinator has gone away or broken the protocol. */
+#define REMOTE_LOST -1
+
+/** Result of joinJob() when the coordinator is running a different job. */
+#define REMOTE_REJECTED -2
+
+/** A worker's connection to its coordinator. */
+typedef struct {
+    /** The connection. */
+    Connection conn;
+
+    /** The engine hashing the leases, and the users it's cracking. */
+    Engine *engine;
+    TargetSet const *targets;
+
+    /** Whether the coordinator told this worker about each digest, so it isn't told
+        back again. */
+    bool *told;
+
+    /** Number of the engine's cracked passwords already reported. */
+    int reported;
+
+    /** Number of seconds the coordinator gives a worker to finish a lease. */
+    int timeout;
+} Remote;
+
+/** starts talking to the coordinator on the given connected socket, for the given
+ * engine and its targets */
+void openRemote( Remote *remote, int fd, Engine *engine, TargetSet const *targets );
+
+/** joins the job, if the coordinator is running the same one, with the same number
+ * of candidates, and learns how long a lease lasts. Returns REMOTE_JOINED, REMOTE_REJECTED or REMOTE_LOST. */
+int joinJob( Remote *remote, long long keyspace, char const *job );
+
+/** asks for a lease of up to size candidates, storing it in lease, and hands the
+ * passwords cracked elsewhere to the engine. Returns REMOTE_RANGE, REMOTE_WAIT,
+ * REMOTE_DONE or REMOTE_LOST. */
+int requestLease( Remote *remote, long long size, Lease *lease );
+
+/** reports the passwords cracked since the last report, and that the lease is
+ * finished. The engine must be idle. Returns false if the coordinator has gone. */
+bool returnLease( Remote *remote, Lease const *lease );
+
+/** closes the connection */
+void closeRemote( Remote *remote );
+
+#endif
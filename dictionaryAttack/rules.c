@@ -0,0 +1,291 @@
+/**
+ * @file rules.c
+ * @author Sean Leana (smleana)
+ * This file parses and applies word-mangling rules. Rules are parsed once into steps,
+ * so applying one to a word is a short loop over a small buffer with no allocation.
+ * The commands follow the usual cracker rule syntax:
+ *
+ *   :    leave the word alone        l    lowercase every letter
+ *   u    uppercase every letter      c    capitalize the first letter, lowercase the rest
+ *   C    lowercase the first letter, uppercase the rest
+ *   t    toggle the case of every letter
+ *   TN   toggle the case of the letter at position N
+ *   r    reverse the word            d    duplicate the word
+ *   f    add the word reversed to the end of it
+ *   $X   add X to the end            ^X   add X to the front
+ *   sXY  replace every X with Y      @X   remove every X
+ *   'N   cut the word to N characters
+ *   [    remove the first character  ]    remove the last character
+ *
+ * Positions are 0 to 9, then A to Z for 10 to 35. Spaces between commands are ignored.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "rules.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+
+/**
+ * Returns the number of characters a rule command takes after it.
+ * @param op the command
+ * @return the number of characters, or -1 if the command isn't known
+ */
+static int argCount(char op)
+{
+    switch (op) {
+    case ':': case 'l': case 'u': case 'c': case 'C': case 't':
+    case 'r': case 'd': case 'f': case '[': case ']':
+        return 0;
+    case 'T': case '$': case '^': case '@': case '\'':
+        return 1;
+    case 's':
+        return 2;
+    default:
+        return -1;
+    }
+}
+
+/**
+ * Decodes a position argument.
+ * @param ch the argument
+ * @return the position, or -1 if ch isn't a position
+ */
+static int position(char ch)
+{
+    if (ch >= '0' && ch <= '9') {
+        return ch - '0';
+    }
+    if (ch >= 'A' && ch <= 'Z') {
+        return ch - 'A' + 10;
+    }
+    return -1;
+}
+
+/**
+ * Initializes an empty rule set.
+ * @param set the rule set
+ */
+void initRuleSet(RuleSet *set)
+{
+    set->rules = NULL;
+    set->count = 0;
+    set->capacity = 0;
+}
+
+/**
+ * Frees the memory used by a rule set.
+ * @param set the rule set
+ */
+void freeRuleSet(RuleSet *set)
+{
+    for (int i = 0; i < set->count; i++) {
+        free(set->rules[i].steps);
+    }
+    free(set->rules);
+    initRuleSet(set);
+}
+
+/**
+ * Parses a rule and adds it to a rule set.
+ * @param set the rule set
+ * @param text the rule
+ * @return false if the rule uses an unknown command, is missing an argument or has a
+ * position that isn't valid
+ */
+bool addRule(RuleSet *set, char const *text)
+{
+    int len = strlen(text);
+    Rule rule;
+    rule.steps = (RuleStep *) malloc((len + 1) * sizeof(RuleStep));
+    rule.count = 0;
+
+    for (int i = 0; i < len; ) {
+        if (text[i] == ' ' || text[i] == '\t') {
+            i++;
+            continue;
+        }
+        RuleStep step = { text[i], '\0', '\0' };
+        int args = argCount(step.op);
+        if (args < 0 || i + args >= len) {
+            free(rule.steps);
+            return false;
+        }
+        if (args >= 1) {
+            step.arg1 = text[i + 1];
+        }
+        if (args == 2) {
+            step.arg2 = text[i + 2];
+        }
+        if ((step.op == 'T' || step.op == '\'') && position(step.arg1) < 0) {
+            free(rule.steps);
+            return false;
+        }
+        rule.steps[rule.count++] = step;
+        i += args + 1;
+    }
+
+    if (set->count >= set->capacity) {
+        set->capacity = set->capacity ? set->capacity * 2 : 16;
+        set->rules = (Rule *) realloc(set->rules, set->capacity * sizeof(Rule));
+    }
+    set->rules[set->count++] = rule;
+    return true;
+}
+
+/**
+ * Reads the rules in a file.
+ * @param set the rule set the rules are added to
+ * @param filename name of the rule file
+ * @param line where the number of the first invalid line is stored, or 0 if the
+ * file couldn't be read
+ * @return false if the file couldn't be read or has an invalid rule
+ */
+bool loadRules(RuleSet *set, char const *filename, int *line)
+{
+    *line = 0;
+    FILE *fp = fopen(filename, "r");
+    if (fp == NULL) {
+        return false;
+    }
+
+    char *text = NULL;
+    size_t capacity = 0;
+    ssize_t len;
+    int number = 0;
+    bool valid = true;
+    while (valid && (len = getline(&text, &capacity, fp)) >= 0) {
+        number++;
+        while (len > 0 && (text[len - 1] == '\n' || text[len - 1] == '\r')) {
+            text[--len] = '\0';
+        }
+        if (len > 0 && text[0] != '#' && !addRule(set, text)) {
+            *line = number;
+            valid = false;
+        }
+    }
+    free(text);
+    fclose(fp);
+    return valid;
+}
+
+/**
+ * Applies a rule to a word. The word can grow past PW_LIMIT while the rule works on
+ * it, up to RULE_WORD_LIMIT, but the result is cut to PW_LIMIT.
+ * @param rule the rule
+ * @param word the word, which doesn't need to be null terminated
+ * @param len length of the word
+ * @param out where the result is stored, null terminated
+ * @return the length of the result
+ */
+int applyRule(Rule const *rule, char const *word, int len, char out[PW_LIMIT + 1])
+{
+    char buf[RULE_WORD_LIMIT];
+    char tmp[RULE_WORD_LIMIT];
+    if (len > RULE_WORD_LIMIT) {
+        len = RULE_WORD_LIMIT;
+    }
+    memcpy(buf, word, len);
+
+    for (int s = 0; s < rule->count; s++) {
+        RuleStep const *step = &rule->steps[s];
+        int n;
+        switch (step->op) {
+        case 'l':
+            for (int i = 0; i < len; i++) {
+                buf[i] = tolower((unsigned char) buf[i]);
+            }
+            break;
+        case 'u':
+            for (int i = 0; i < len; i++) {
+                buf[i] = toupper((unsigned char) buf[i]);
+            }
+            break;
+        case 'c':
+        case 'C':
+            for (int i = 0; i < len; i++) {
+                bool upper = (i == 0) == (step->op == 'c');
+                buf[i] = upper ? toupper((unsigned char) buf[i]) : tolower((unsigned char) buf[i]);
+            }
+            break;
+        case 't':
+        case 'T':
+            for (int i = 0; i < len; i++) {
+                if (step->op == 't' || i == position(step->arg1)) {
+                    unsigned char ch = buf[i];
+                    buf[i] = isupper(ch) ? tolower(ch) : toupper(ch);
+                }
+            }
+            break;
+        case 'r':
+            for (int i = 0; i < len / 2; i++) {
+                char ch = buf[i];
+                buf[i] = buf[len - 1 - i];
+                buf[len - 1 - i] = ch;
+            }
+            break;
+        case 'd':
+        case 'f':
+            n = len * 2 > RULE_WORD_LIMIT ? RULE_WORD_LIMIT - len : len;
+            for (int i = 0; i < n; i++) {
+                buf[len + i] = step->op == 'd' ? buf[i] : buf[len - 1 - i];
+            }
+            len += n;
+            break;
+        case '$':
+            if (len < RULE_WORD_LIMIT) {
+                buf[len++] = step->arg1;
+            }
+            break;
+        case '^':
+            n = len < RULE_WORD_LIMIT ? len : RULE_WORD_LIMIT - 1;
+            memcpy(tmp, buf, n);
+            buf[0] = step->arg1;
+            memcpy(buf + 1, tmp, n);
+            len = n + 1;
+            break;
+        case 's':
+            for (int i = 0; i < len; i++) {
+                if (buf[i] == step->arg1) {
+                    buf[i] = step->arg2;
+                }
+            }
+            break;
+        case '@':
+            n = 0;
+            for (int i = 0; i < len; i++) {
+                if (buf[i] != step->arg1) {
+                    buf[n++] = buf[i];
+                }
+            }
+            len = n;
+            break;
+        case '\'':
+            if (len > position(step->arg1)) {
+                len = position(step->arg1);
+            }
+            break;
+        case '[':
+            if (len > 0) {
+                memmove(buf, buf + 1, --len);
+            }
+            break;
+        case ']':
+            if (len > 0) {
+                len--;
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    if (len > PW_LIMIT) {
+        len = PW_LIMIT;
+    }
+    memcpy(out, buf, len);
+    out[len] = '\0';
+    return len;
+}
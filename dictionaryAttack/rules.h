@@ -0,0 +1,57 @@
+/**
+ * @file rules.h
+ * @author Sean Leana (smleana)
+ * This file defines word-mangling rules. A rule is a list of simple edits, like
+ * capitalizing a word or adding a digit to the end, written one command after another
+ * in the style of other password crackers. Each candidate word can be turned into one
+ * new candidate per rule as it's fed to the hashers.
+ */
+
+#ifndef _RULES_H_
+#define _RULES_H_
+
+#include "password.h"
+#include <stdbool.h>
+
+/** Longest a word can get while a rule is working on it. */
+#define RULE_WORD_LIMIT 64
+
+/** One edit in a rule: a command and up to two characters it works with. */
+typedef struct {
+    char op;
+    char arg1;
+    char arg2;
+} RuleStep;
+
+/** A rule, applied to a word one step after another. */
+typedef struct {
+    RuleStep *steps;
+    int count;
+} Rule;
+
+/** A list of rules, in the order they're applied. */
+typedef struct {
+    Rule *rules;
+    int count;
+    int capacity;
+} RuleSet;
+
+/** initializes an empty rule set */
+void initRuleSet( RuleSet *set );
+
+/** frees the memory used by a rule set */
+void freeRuleSet( RuleSet *set );
+
+/** parses one rule and adds it to the set. Returns false if the rule isn't valid. */
+bool addRule( RuleSet *set, char const *text );
+
+/** reads a rule file, one rule per line, skipping blank lines and lines starting with
+ * #. Returns false, with errno set, if the file can't be read, or with line set to
+ * the line number of the first invalid rule. */
+bool loadRules( RuleSet *set, char const *filename, int *line );
+
+/** applies a rule to a word of len characters, storing the result, cut to PW_LIMIT
+ * characters, in out and returning its length */
+int applyRule( Rule const *rule, char const *word, int len, char out[ PW_LIMIT + 1 ] );
+
+#endif
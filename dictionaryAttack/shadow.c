@@ -0,0 +1,141 @@
+/**
+ * @file shadow.c
+ * @author Sean Leana (smleana)
+ * This file reads shadow files in one pass. Lines are found in a large buffer with
+ * memchr, and each entry is checked and split by looking at where its separators
+ * have to be, writing nulls over them so the fields can be used where they are.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "shadow.h"
+#include "target.h"
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+/** What has to come between a user's name and salt, for an md5 password hash. */
+#define MD5_PREFIX ":$1$"
+
+/**
+ * Reads more of the file into the buffer, after moving what's left of the buffer to
+ * the front. Stops when the buffer is full or the file runs out.
+ * @param shadow the shadow file
+ */
+static void fillBuffer(ShadowFile *shadow)
+{
+    memmove(shadow->buffer, shadow->buffer + shadow->start, shadow->end - shadow->start);
+    shadow->end -= shadow->start;
+    shadow->start = 0;
+    while (!shadow->eof && shadow->end < SHADOW_BUFFER) {
+        ssize_t n = read(shadow->fd, shadow->buffer + shadow->end, SHADOW_BUFFER - shadow->end);
+        if (n <= 0) {
+            shadow->eof = true;
+        } else {
+            shadow->end += n;
+        }
+    }
+}
+
+/**
+ * Checks one line and splits it into the fields of an entry. A valid line is a name
+ * of up to USERNAME_LIMIT characters, then ":$1$", a salt of SALT_LENGTH characters,
+ * "$", and a hash of PW_HASH_LIMIT characters that ends the line or is followed by
+ * ":" and any other fields.
+ * @param line the start of the line
+ * @param len length of the line, without its newline
+ * @param entry where the fields are stored
+ * @return true if the line is a valid entry
+ */
+static bool parseLine(char *line, size_t len, ShadowEntry *entry)
+{
+    char *end = line + len;
+    char *colon = memchr(line, ':', len);
+    if (colon == NULL || colon == line || colon - line > USERNAME_LIMIT
+            || memchr(line, ' ', colon - line) != NULL) {
+        return false;
+    }
+
+    char *salt = colon + strlen(MD5_PREFIX);
+    char *hash = salt + SALT_LENGTH + 1;
+    if (hash + PW_HASH_LIMIT > end || strncmp(colon, MD5_PREFIX, strlen(MD5_PREFIX)) != 0
+            || memchr(salt, '$', SALT_LENGTH) != NULL || memchr(salt, ' ', SALT_LENGTH) != NULL
+            || salt[SALT_LENGTH] != '$') {
+        return false;
+    }
+    if (hash + PW_HASH_LIMIT < end && hash[PW_HASH_LIMIT] != ':') {
+        return false;
+    }
+
+    *colon = '\0';
+    salt[SALT_LENGTH] = '\0';
+    hash[PW_HASH_LIMIT] = '\0';
+    entry->name = line;
+    entry->salt = salt;
+    entry->hash = hash;
+    return true;
+}
+
+/**
+ * Opens a shadow file for reading.
+ * @param shadow the shadow file to fill in
+ * @param filename name of the file
+ * @return false if the file couldn't be opened, with errno set
+ */
+bool openShadow(ShadowFile *shadow, char const *filename)
+{
+    shadow->fd = open(filename, O_RDONLY);
+    if (shadow->fd < 0) {
+        return false;
+    }
+    shadow->buffer = (char *) malloc(SHADOW_BUFFER + 1);
+    shadow->start = 0;
+    shadow->end = 0;
+    shadow->eof = false;
+    return true;
+}
+
+/**
+ * Reads the next entry from a shadow file.
+ * @param shadow the shadow file
+ * @param entry where the fields of the entry are stored
+ * @return SHADOW_ENTRY, or SHADOW_END if there are no more entries, or
+ * SHADOW_INVALID if the next line isn't a valid entry
+ */
+int readShadowEntry(ShadowFile *shadow, ShadowEntry *entry)
+{
+    for (;;) {
+        char *line = shadow->buffer + shadow->start;
+        char *nl = memchr(line, '\n', shadow->end - shadow->start);
+        if (nl == NULL && !shadow->eof) {
+            fillBuffer(shadow);
+            line = shadow->buffer;
+            nl = memchr(line, '\n', shadow->end);
+            if (nl == NULL && !shadow->eof) {
+                // The line doesn't fit in the buffer.
+                return SHADOW_INVALID;
+            }
+        }
+
+        size_t len = (nl ? nl : shadow->buffer + shadow->end) - line;
+        if (len == 0 && nl == NULL) {
+            return SHADOW_END;
+        }
+        shadow->start = line + len - shadow->buffer + (nl ? 1 : 0);
+        if (len > 0) {
+            return parseLine(line, len, entry) ? SHADOW_ENTRY : SHADOW_INVALID;
+        }
+    }
+}
+
+/**
+ * Closes a shadow file.
+ * @param shadow the shadow file
+ */
+void closeShadow(ShadowFile *shadow)
+{
+    close(shadow->fd);
+    free(shadow->buffer);
+    shadow->buffer = NULL;
+}
@@ -0,0 +1,59 @@
+/**
+ * @file shadow.h
+ * @author Sean Leana (smleana)
+ * This file defines a streaming reader for shadow files. The file is read in large
+ * chunks, and each entry's fields are sliced out of the buffer in place, so a file of
+ * any length is read in constant memory.
+ */
+
+#ifndef _SHADOW_H_
+#define _SHADOW_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/** Size of the buffer a shadow file is read through; no line may be longer. */
+#define SHADOW_BUFFER 1048576
+
+/** Result of readShadowEntry() when it found a valid entry. */
+#define SHADOW_ENTRY 1
+
+/** Result of readShadowEntry() at the end of the file. */
+#define SHADOW_END 0
+
+/** Result of readShadowEntry() when the next line isn't a valid entry. */
+#define SHADOW_INVALID -1
+
+/** A shadow file being read. */
+typedef struct {
+    /** The open file. */
+    int fd;
+
+    /** Buffer the file is read into, and the part of it not parsed yet. */
+    char *buffer;
+    size_t start;
+    size_t end;
+
+    /** Set once the whole file has been read into the buffer. */
+    bool eof;
+} ShadowFile;
+
+/** The fields of one entry, null terminated in the reader's buffer. They stay valid
+    until the next entry is read. */
+typedef struct {
+    char *name;
+    char *salt;
+    char *hash;
+} ShadowEntry;
+
+/** opens the given shadow file. Returns false, with errno set, if it can't be opened. */
+bool openShadow( ShadowFile *shadow, char const *filename );
+
+/** reads the next entry, skipping blank lines, and returns SHADOW_ENTRY, SHADOW_END
+ * or SHADOW_INVALID */
+int readShadowEntry( ShadowFile *shadow, ShadowEntry *entry );
+
+/** closes the file and frees the buffer */
+void closeShadow( ShadowFile *shadow );
+
+#endif
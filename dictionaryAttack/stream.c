@@ -0,0 +1,111 @@
+/**
+ * @file stream.c
+ * @author Sean Leana (smleana)
+ * This file reads words from a stream. Whatever part of the buffer hasn't been used
+ * yet is moved to the front before each read, and a read takes whatever has arrived
+ * rather than waiting for the buffer to fill, so words are handed on as soon as their
+ * line is complete.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "stream.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+/**
+ * Waits for more of the stream and adds it to the buffer, after moving what's left
+ * of the buffer to the front. A signal ends the wait early, so the caller can see
+ * whether it was asked to stop.
+ * @param stream the stream
+ * @return false if a signal arrived before anything was read
+ */
+static bool fillBuffer(WordStream *stream)
+{
+    memmove(stream->buffer, stream->buffer + stream->start, stream->end - stream->start);
+    stream->end -= stream->start;
+    stream->start = 0;
+    ssize_t n = read(stream->fd, stream->buffer + stream->end, STREAM_BUFFER - stream->end);
+    if (n < 0 && errno == EINTR) {
+        return false;
+    }
+    if (n <= 0) {
+        stream->eof = true;
+    } else {
+        stream->end += n;
+    }
+    return true;
+}
+
+/**
+ * Starts reading a stream.
+ * @param stream the stream to fill in
+ * @param fd the file descriptor to read from
+ */
+void openWordStream(WordStream *stream, int fd)
+{
+    stream->fd = fd;
+    stream->buffer = (char *) malloc(STREAM_BUFFER);
+    stream->start = 0;
+    stream->end = 0;
+    stream->eof = false;
+}
+
+/**
+ * Reports whether a whole line is already in the buffer, or the stream has ended.
+ * @param stream the stream
+ * @return true if reading the next word won't have to wait
+ */
+bool wordReady(WordStream const *stream)
+{
+    return stream->eof
+        || memchr(stream->buffer + stream->start, '\n', stream->end - stream->start) != NULL;
+}
+
+/**
+ * Reads the next word from a stream, waiting for it if it hasn't all arrived.
+ * @param stream the stream
+ * @param word where the word is stored
+ * @return STREAM_WORD, or STREAM_END at the end of the stream, STREAM_INVALID if
+ * the word contains a space or is longer than PW_LIMIT, or STREAM_INTERRUPTED if a
+ * signal arrived while waiting for it
+ */
+int readStreamWord(WordStream *stream, char word[PW_LIMIT + 1])
+{
+    char *line = stream->buffer + stream->start;
+    char *nl = memchr(line, '\n', stream->end - stream->start);
+
+    // A line longer than any word can't be valid, so there's no need to wait for all
+    // of it.
+    while (nl == NULL && !stream->eof && stream->end - stream->start <= PW_LIMIT) {
+        if (!fillBuffer(stream)) {
+            return STREAM_INTERRUPTED;
+        }
+        line = stream->buffer + stream->start;
+        nl = memchr(line, '\n', stream->end - stream->start);
+    }
+
+    size_t len = (nl ? nl : stream->buffer + stream->end) - line;
+    if (nl == NULL && len == 0) {
+        return STREAM_END;
+    }
+    if (len > PW_LIMIT || memchr(line, ' ', len) != NULL) {
+        return STREAM_INVALID;
+    }
+    memcpy(word, line, len);
+    word[len] = '\0';
+    stream->start += len + (nl ? 1 : 0);
+    return STREAM_WORD;
+}
+
+/**
+ * Frees the buffer of a stream.
+ * @param stream the stream
+ */
+void closeWordStream(WordStream *stream)
+{
+    free(stream->buffer);
+    stream->buffer = NULL;
+}
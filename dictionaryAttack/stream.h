@@ -0,0 +1,59 @@
+/**
+ * @file stream.h
+ * @author Sean Leana (smleana)
+ * This file defines a reader for candidate words that arrive on a pipe or standard
+ * input. Words are read through one large buffer as they come in, so a stream of any
+ * length is read in constant memory and nothing has to wait for the end of it.
+ */
+
+#ifndef _STREAM_H_
+#define _STREAM_H_
+
+#include "password.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+/** Size of the buffer a stream is read through. */
+#define STREAM_BUFFER 1048576
+
+/** Result of readStreamWord() when it read a word. */
+#define STREAM_WORD 1
+
+/** Result of readStreamWord() at the end of the stream. */
+#define STREAM_END 0
+
+/** Result of readStreamWord() when the next word contains a space or is too long. */
+#define STREAM_INVALID -1
+
+/** Result of readStreamWord() when a signal arrived while it waited for the next word,
+    which can still be read by calling it again. */
+#define STREAM_INTERRUPTED -2
+
+/** A stream of words, one per line. */
+typedef struct {
+    /** The file descriptor the words come from. */
+    int fd;
+
+    /** Buffer the stream is read into, and the part of it not used yet. */
+    char *buffer;
+    size_t start;
+    size_t end;
+
+    /** Set once the stream has ended. */
+    bool eof;
+} WordStream;
+
+/** starts reading words from the given file descriptor */
+void openWordStream( WordStream *stream, int fd );
+
+/** returns true if the next word can be read without waiting for more input */
+bool wordReady( WordStream const *stream );
+
+/** copies the next word into word, null terminated, and returns STREAM_WORD,
+ * STREAM_END, STREAM_INVALID or STREAM_INTERRUPTED */
+int readStreamWord( WordStream *stream, char word[ PW_LIMIT + 1 ] );
+
+/** frees the buffer; the file descriptor is left open */
+void closeWordStream( WordStream *stream );
+
+#endif
@@ -0,0 +1,252 @@
+/**
+ * @file target.c
+ * @author Sean Leana (smleana)
+ * This file keeps track of the users we're trying to crack. Users are grouped by salt,
+ * and each salt group has an open-addressing table of the distinct hashes that use it,
+ * so a candidate hashed with that salt can be checked against all of them at once.
+ */
+
+#include "target.h"
+#include <stdlib.h>
+#include <string.h>
+
+/** Initial number of slots in a hash table. */
+#define INITIAL_SLOTS 8
+
+/**
+ * Returns the first word of a hash value, used to place it in a digest table.
+ * @param hash the hash value
+ * @return its first word
+ */
+static word hashPrefix(byte const hash[HASH_SIZE])
+{
+    word prefix;
+    memcpy(&prefix, hash, sizeof(prefix));
+    return prefix;
+}
+
+/**
+ * Hashes a salt string for the table of salt groups (FNV-1a).
+ * @param salt the salt
+ * @return the hash of the salt
+ */
+static word saltHash(char const salt[SALT_LENGTH + 1])
+{
+    word h = 2166136261U;
+    for (int i = 0; i < SALT_LENGTH; i++) {
+        h = (h ^ (byte) salt[i]) * 16777619U;
+    }
+    return h;
+}
+
+/**
+ * Makes sure the given array has room for one more element, doubling its capacity
+ * if it's full.
+ * @param array pointer to the array
+ * @param capacity pointer to its capacity
+ * @param count number of elements in use
+ * @param size size of each element
+ */
+static void growArray(void **array, int *capacity, int count, size_t size)
+{
+    if (count >= *capacity) {
+        *capacity = *capacity ? *capacity * 2 : INITIAL_SLOTS;
+        *array = realloc(*array, *capacity * size);
+    }
+}
+
+/**
+ * Puts a digest into a salt group's table, without checking whether it's already
+ * there or whether the table has room.
+ * @param set the target set
+ * @param group the salt group
+ * @param digest index of the digest to insert
+ */
+static void insertSlot(TargetSet *set, SaltGroup *group, int digest)
+{
+    word prefix = hashPrefix(set->digests[digest].hash);
+    int mask = group->capacity - 1;
+    int i = prefix & mask;
+    while (group->slots[i].digest >= 0) {
+        i = (i + 1) & mask;
+    }
+    group->slots[i].prefix = prefix;
+    group->slots[i].digest = digest;
+}
+
+/**
+ * Doubles the size of a salt group's digest table, reinserting everything in it.
+ * @param set the target set
+ * @param group the salt group
+ */
+static void growSlots(TargetSet *set, SaltGroup *group)
+{
+    DigestSlot *old = group->slots;
+    int oldCapacity = group->capacity;
+
+    group->capacity = oldCapacity ? oldCapacity * 2 : INITIAL_SLOTS;
+    group->slots = (DigestSlot *) malloc(group->capacity * sizeof(DigestSlot));
+    for (int i = 0; i < group->capacity; i++) {
+        group->slots[i].digest = -1;
+    }
+    for (int i = 0; i < oldCapacity; i++) {
+        if (old[i].digest >= 0) {
+            insertSlot(set, group, old[i].digest);
+        }
+    }
+    free(old);
+}
+
+/**
+ * Doubles the size of the table of salt groups, reinserting every group.
+ * @param set the target set
+ */
+static void growSaltSlots(TargetSet *set)
+{
+    free(set->saltSlots);
+    set->saltCapacity = set->saltCapacity ? set->saltCapacity * 2 : INITIAL_SLOTS;
+    set->saltSlots = (int *) malloc(set->saltCapacity * sizeof(int));
+    for (int i = 0; i < set->saltCapacity; i++) {
+        set->saltSlots[i] = -1;
+    }
+
+    int mask = set->saltCapacity - 1;
+    for (int g = 0; g < set->groupCount; g++) {
+        int i = saltHash(set->groups[g].salt) & mask;
+        while (set->saltSlots[i] >= 0) {
+            i = (i + 1) & mask;
+        }
+        set->saltSlots[i] = g;
+    }
+}
+
+/**
+ * Finds the salt group for the given salt, making a new one if this is the first
+ * time we've seen it.
+ * @param set the target set
+ * @param salt the salt
+ * @return index of the salt group
+ */
+static int findGroup(TargetSet *set, char const salt[SALT_LENGTH + 1])
+{
+    if (2 * (set->groupCount + 1) > set->saltCapacity) {
+        growSaltSlots(set);
+    }
+
+    int mask = set->saltCapacity - 1;
+    int i = saltHash(salt) & mask;
+    while (set->saltSlots[i] >= 0) {
+        if (strcmp(set->groups[set->saltSlots[i]].salt, salt) == 0) {
+            return set->saltSlots[i];
+        }
+        i = (i + 1) & mask;
+    }
+
+    growArray((void **) &set->groups, &set->groupCapacity, set->groupCount, sizeof(SaltGroup));
+    int g = set->groupCount++;
+    SaltGroup *group = &set->groups[g];
+    strcpy(group->salt, salt);
+    group->slots = NULL;
+    group->capacity = 0;
+    group->count = 0;
+    growSlots(set, group);
+
+    set->saltSlots[i] = g;
+    return g;
+}
+
+/**
+ * Initializes an empty target set.
+ * @param set the target set to initialize
+ */
+void initTargetSet(TargetSet *set)
+{
+    memset(set, 0, sizeof(TargetSet));
+}
+
+/**
+ * Frees all the memory used by a target set.
+ * @param set the target set
+ */
+void freeTargetSet(TargetSet *set)
+{
+    for (int g = 0; g < set->groupCount; g++) {
+        free(set->groups[g].slots);
+    }
+    free(set->groups);
+    free(set->digests);
+    free(set->users);
+    free(set->saltSlots);
+    initTargetSet(set);
+}
+
+/**
+ * Adds a user to the target set. If another user already has the same salt and hash,
+ * the new user is chained onto that digest rather than making a new one, so a match
+ * reports both users together.
+ * @param set the target set
+ * @param name the user name
+ * @param salt the user's salt
+ * @param hash the user's decoded hash
+ * @return index of the new user
+ */
+int addTarget(TargetSet *set, char const *name, char const salt[SALT_LENGTH + 1],
+        byte const hash[HASH_SIZE])
+{
+    int g = findGroup(set, salt);
+    int d = findDigest(set, g, hash);
+    if (d < 0) {
+        growArray((void **) &set->digests, &set->digestCapacity, set->digestCount, sizeof(Digest));
+        d = set->digestCount++;
+        Digest *digest = &set->digests[d];
+        memcpy(digest->hash, hash, HASH_SIZE);
+        digest->group = g;
+        digest->firstUser = -1;
+        digest->lastUser = -1;
+
+        SaltGroup *group = &set->groups[g];
+        if (2 * (group->count + 1) > group->capacity) {
+            growSlots(set, group);
+        }
+        insertSlot(set, group, d);
+        group->count++;
+    }
+
+    growArray((void **) &set->users, &set->userCapacity, set->userCount, sizeof(Target));
+    int u = set->userCount++;
+    Target *user = &set->users[u];
+    strncpy(user->name, name, USERNAME_LIMIT);
+    user->name[USERNAME_LIMIT] = '\0';
+    user->digest = d;
+    user->next = -1;
+
+    Digest *digest = &set->digests[d];
+    if (digest->lastUser < 0) {
+        digest->firstUser = u;
+    } else {
+        set->users[digest->lastUser].next = u;
+    }
+    digest->lastUser = u;
+    return u;
+}
+
+/**
+ * Looks for a hash value among the digests of one salt group.
+ * @param set the target set
+ * @param group index of the salt group
+ * @param hash the hash value to look for
+ * @return index of the matching digest, or -1 if no user in this group has this hash
+ */
+int findDigest(TargetSet const *set, int group, byte const hash[HASH_SIZE])
+{
+    SaltGroup const *g = &set->groups[group];
+    word prefix = hashPrefix(hash);
+    int mask = g->capacity - 1;
+    for (int i = prefix & mask; g->slots[i].digest >= 0; i = (i + 1) & mask) {
+        if (g->slots[i].prefix == prefix
+                && memcmp(set->digests[g->slots[i].digest].hash, hash, HASH_SIZE) == 0) {
+            return g->slots[i].digest;
+        }
+    }
+    return -1;
+}
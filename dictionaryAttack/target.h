@@ -0,0 +1,103 @@
+/**
+ * @file target.h
+ * @author Sean Leana (smleana)
+ * This file defines the set of shadow file entries we're trying to crack. Entries are
+ * grouped by salt, so each candidate only needs to be hashed once per distinct salt,
+ * and entries with the same salt and hash are collapsed into one digest.
+ */
+
+#ifndef _TARGET_H_
+#define _TARGET_H_
+
+#include "password.h"
+
+/** Maximum username length */
+#define USERNAME_LIMIT 32
+
+/** One user from the shadow file. */
+typedef struct {
+    /** The user's name. */
+    char name[USERNAME_LIMIT + 1];
+
+    /** Index of this user's salt and hash in the digests array. */
+    int digest;
+
+    /** Next user, in shadow file order, with the same salt and hash, or -1. */
+    int next;
+} Target;
+
+/** A distinct salt and hash pair. Every user that shares it has the same password. */
+typedef struct {
+    /** The decoded hash value. */
+    byte hash[HASH_SIZE];
+
+    /** Index of the salt group this hash belongs to. */
+    int group;
+
+    /** First and last users with this salt and hash, in shadow file order. */
+    int firstUser;
+    int lastUser;
+} Digest;
+
+/** One slot in a salt group's open-addressing table of hashes. */
+typedef struct {
+    /** First word of the hash, so most probes never leave the table. */
+    word prefix;
+
+    /** Index of the digest in this slot, or -1 if the slot is empty. */
+    int digest;
+} DigestSlot;
+
+/** All the distinct hashes that use one salt. */
+typedef struct {
+    /** The salt these hashes share. */
+    char salt[SALT_LENGTH + 1];
+
+    /** Open-addressing table of the digests, indexed by hash prefix. */
+    DigestSlot *slots;
+
+    /** Number of slots in the table, always a power of two. */
+    int capacity;
+
+    /** Number of digests in the table. */
+    int count;
+} SaltGroup;
+
+/** All the users we're trying to crack, with their hashes grouped by salt. */
+typedef struct {
+    /** Users in shadow file order. */
+    Target *users;
+    int userCount;
+    int userCapacity;
+
+    /** Distinct salt and hash pairs, in the order they were first seen. */
+    Digest *digests;
+    int digestCount;
+    int digestCapacity;
+
+    /** Distinct salts, in the order they were first seen. */
+    SaltGroup *groups;
+    int groupCount;
+    int groupCapacity;
+
+    /** Open-addressing table of group indices, indexed by salt, -1 for an empty slot. */
+    int *saltSlots;
+    int saltCapacity;
+} TargetSet;
+
+/** initializes an empty target set */
+void initTargetSet( TargetSet *set );
+
+/** frees the memory used by a target set */
+void freeTargetSet( TargetSet *set );
+
+/** adds a user with the given salt and decoded hash to the set, returning the
+ * index of the new user */
+int addTarget( TargetSet *set, char const *name, char const salt[ SALT_LENGTH + 1 ],
+               byte const hash[ HASH_SIZE ] );
+
+/** looks for the given hash among the digests of one salt group, returning the index
+ * of the matching digest or -1 if there isn't one */
+int findDigest( TargetSet const *set, int group, byte const hash[ HASH_SIZE ] );
+
+#endif
@@ -1,7 +1,8 @@
 /**
  @file unitTest.c
  @author CSC230 Instructors
- Unit test program for the block, md5 and password components.
+ Unit test program for the block, md5, password, target, writer, dictionary, shadow,
+ stream, rules and mask components.
 */
 
 #include <stdlib.h>
@@ -12,9 +13,21 @@
 #include "block.h"
 #include "md5.h"
 #include "password.h"
+#include "target.h"
+#include "writer.h"
+#include "dictionary.h"
+#include "shadow.h"
+#include "stream.h"
+#include "rules.h"
+#include "mask.h"
+#include "dedup.h"
+#include "potfile.h"
+#include "checkpoint.h"
+#include "merge.h"
+#include "lease.h"
 
 /** Number of tests we should have, if they're all turned on. */
-#define EXPECTED_TOTAL 60
+#define EXPECTED_TOTAL 102
 
 /** Total number or tests we tried. */
 static int totalTests = 0;
@@ -56,7 +69,6 @@ int gVersion1( int idx );
 int gVersion2( int idx );
 int gVersion3( int idx );
 word rotateLeft( word value, int s );
-void padBlock( Block *block );
 void md5Iteration( word M[ 16 ], word *A, word *B,
                    word *C, word *D, int i );
 
@@ -400,6 +412,97 @@ int main()
     freeBlock( block );
   }
 
+  // Test the unrolled md5HashPadded() against 64 calls to md5Iteration().
+
+  {
+    Block block;
+    initBlock( &block );
+    for ( int i = 0; i < 50; i++ )
+      appendByte( &block, (byte) ( i * 37 + 11 ) );
+    padBlock( &block );
+
+    word M[ 16 ];
+    for ( int i = 0; i < 16; i++ )
+      M[ i ] = block.data[ i * 4 ] | ( block.data[ i * 4 + 1 ] << 8 ) |
+        ( block.data[ i * 4 + 2 ] << 16 ) | ( (word) block.data[ i * 4 + 3 ] << 24 );
+    word A = md5Initial[ 0 ], B = md5Initial[ 1 ], C = md5Initial[ 2 ], D = md5Initial[ 3 ];
+    for ( int i = 0; i < 64; i++ )
+      md5Iteration( M, &A, &B, &C, &D, i );
+    word state[] = { A + md5Initial[ 0 ], B + md5Initial[ 1 ],
+                     C + md5Initial[ 2 ], D + md5Initial[ 3 ] };
+    byte expected[ HASH_SIZE ];
+    for ( int i = 0; i < HASH_SIZE; i++ )
+      expected[ i ] = ( state[ i / 4 ] >> ( 8 * ( i % 4 ) ) ) & 0xFF;
+
+    byte hash[ HASH_SIZE ];
+    md5HashPadded( &block, hash );
+    TestCase( cmpBytes( hash, expected, HASH_SIZE ) );
+  }
+
+  // Test the md5HashBatch() function against md5HashPadded().
+
+  {
+    // Enough blocks to fill several sets of lanes and leave a partial set.
+    Block blocks[ 19 ];
+    Block *ptrs[ 19 ];
+    byte hash[ 19 ][ HASH_SIZE ];
+    for ( int i = 0; i < 19; i++ ) {
+      blocks[ i ].len = 0;
+      for ( int j = 0; j < i * 3; j++ )
+        appendByte( &blocks[ i ], (byte) ( i * 31 + j * 7 ) );
+      padBlock( &blocks[ i ] );
+      ptrs[ i ] = &blocks[ i ];
+    }
+
+    md5HashBatch( ptrs, 19, hash );
+
+    bool match = true;
+    for ( int i = 0; i < 19; i++ ) {
+      byte single[ HASH_SIZE ];
+      md5HashPadded( &blocks[ i ], single );
+      if ( !cmpBytes( hash[ i ], single, HASH_SIZE ) )
+        match = false;
+    }
+    TestCase( match );
+
+    // A short batch that only partly fills one set of lanes.
+    md5HashBatch( ptrs + 4, 3, hash );
+    match = true;
+    for ( int i = 0; i < 3; i++ ) {
+      byte single[ HASH_SIZE ];
+      md5HashPadded( &blocks[ i + 4 ], single );
+      if ( !cmpBytes( hash[ i ], single, HASH_SIZE ) )
+        match = false;
+    }
+    TestCase( match );
+
+    // A known hash in the middle of a batch.
+    blocks[ 5 ].len = 0;
+    appendString( &blocks[ 5 ], "The quick brown fox jumps over the lazy dog" );
+    padBlock( &blocks[ 5 ] );
+    md5HashBatch( ptrs, 8, hash );
+    byte expected[] = { 0x9E, 0x10, 0x7D, 0x9D, 0x37, 0x2B, 0xB6, 0x82,
+                        0x6B, 0xD8, 0x1D, 0x35, 0x42, 0xA4, 0x19, 0xD6 };
+    TestCase( cmpBytes( hash[ 5 ], expected, HASH_SIZE ) );
+
+    // Every kernel this CPU can run should agree with the scalar path.
+    char const *names[] = { "scalar", "sse2", "avx2", "avx512" };
+    match = true;
+    for ( int k = 0; k < 4; k++ ) {
+      if ( !md5SelectKernel( names[ k ] ) )
+        continue;
+      md5HashBatch( ptrs, 19, hash );
+      for ( int i = 0; i < 19; i++ ) {
+        byte single[ HASH_SIZE ];
+        md5HashPadded( &blocks[ i ], single );
+        if ( !cmpBytes( hash[ i ], single, HASH_SIZE ) )
+          match = false;
+      }
+    }
+    md5SelectKernel( NULL );
+    TestCase( match );
+  }
+
   ///////////////////////////////////////////////////////////////
   // Test the password component
 
@@ -533,6 +636,37 @@ int main()
     TestCase( strcmp( result, "JKUg1ByWFvKwjFHwMFLcD1" ) == 0 );
   }
  
+  // Test the stringToHash() function
+
+  {
+    // The reverse of the first hashToString() test.
+    byte expected[] = { 0x95, 0xA7, 0x2B, 0x5F, 0x1F, 0x2D, 0xB6, 0x4A,
+                        0x07, 0xC9, 0xBF, 0xCB, 0xD8, 0x95, 0x86, 0x8B };
+    byte hash[ HASH_SIZE ];
+
+    TestCase( stringToHash( "MPPZJeod4Sk89awLhwv591", hash ) &&
+              cmpBytes( hash, expected, HASH_SIZE ) );
+  }
+
+  {
+    // Round trip through hashToString() and back.
+    byte hash[] = { 0xB2, 0x8B, 0xF1, 0xF1, 0xA1, 0x58, 0x05, 0xE3,
+                    0x6E, 0x34, 0x74, 0xCF, 0x95, 0x43, 0xD1, 0x6F };
+    char str[ PW_HASH_LIMIT + 1 ];
+    byte back[ HASH_SIZE ];
+
+    hashToString( hash, str );
+    TestCase( stringToHash( str, back ) && cmpBytes( hash, back, HASH_SIZE ) );
+  }
+
+  {
+    // Characters outside the encoding, and strings of the wrong length.
+    byte hash[ HASH_SIZE ];
+    TestCase( !stringToHash( "MPPZJeod4Sk89awLhwv5*1", hash ) &&
+              !stringToHash( "MPPZJeod4Sk89awLhwv59", hash ) &&
+              !stringToHash( "MPPZJeod4Sk89awLhwv59z", hash ) );
+  }
+
   // Test the hashPassword() function
   
   {
@@ -560,6 +694,420 @@ int main()
     // Make sure we got the right result.
     TestCase( strcmp( result, "JKUg1ByWFvKwjFHwMFLcD1" ) == 0 );
   }
+
+  // Test the hashPasswordBatch() function
+
+  {
+    // The two known passwords, mixed in with others of different lengths
+    // and salts so the lanes don't all share a block layout.
+    char const *pass[] = { "abc123", "a", "password", "", "fifteen-letters",
+                           "qazwsx", "password", "trustno1", "x", "ninja",
+                           "batman", "hello", "abc123", "0123456789",
+                           "letmein", "dragon", "monkey", "abc123" };
+    char const *salt[] = { "abcdefgh", "rVu9zC1N", "rVu9zC1N", "abcdefgh",
+                           "b4dnFz8g", "dBufmvX4", "abcdefgh", "kdyV/Vwb",
+                           "C0o/VxQ5", "amBrlMXO", "ZR3LMdSI", "fmB4PoIF",
+                           "y/yLeQfK", "abcdefgh", "rVu9zC1N", "b4dnFz8g",
+                           "dBufmvX4", "abcdefgh" };
+    int n = sizeof( pass ) / sizeof( pass[ 0 ] );
+    char result[ 18 ][ PW_HASH_LIMIT + 1 ];
+
+    hashPasswordBatch( pass, salt, n, result );
+
+    TestCase( strcmp( result[ 0 ], "MPPZJeod4Sk89awLhwv591" ) == 0 &&
+              strcmp( result[ 2 ], "JKUg1ByWFvKwjFHwMFLcD1" ) == 0 );
+
+    bool match = true;
+    for ( int i = 0; i < n; i++ ) {
+      char single[ PW_HASH_LIMIT + 1 ];
+      hashPassword( pass[ i ], salt[ i ], single );
+      if ( strcmp( result[ i ], single ) != 0 )
+        match = false;
+    }
+    TestCase( match );
+  }
+
+  ///////////////////////////////////////////////////////////////
+  // Test the target component
+
+  {
+    TargetSet set;
+    initTargetSet( &set );
+
+    byte h1[ HASH_SIZE ], h2[ HASH_SIZE ], h3[ HASH_SIZE ];
+    stringToHash( "aKsVVoNzLcSBRrhy4mexs.", h1 );
+    stringToHash( "MPPZJeod4Sk89awLhwv591", h2 );
+    stringToHash( "JKUg1ByWFvKwjFHwMFLcD1", h3 );
+
+    // Two salts, with one salt and hash pair shared by two users.
+    addTarget( &set, "bob", "dBufmvX4", h1 );
+    addTarget( &set, "eval", "abcdefgh", h2 );
+    addTarget( &set, "bob2", "dBufmvX4", h1 );
+    addTarget( &set, "pat", "dBufmvX4", h3 );
+
+    TestCase( set.userCount == 4 && set.groupCount == 2 && set.digestCount == 3 );
+
+    // The shared digest should list both users, in the order they were added.
+    int d = findDigest( &set, 0, h1 );
+    TestCase( d >= 0 && set.users[ set.digests[ d ].firstUser ].next == 2 &&
+              strcmp( set.users[ set.digests[ d ].firstUser ].name, "bob" ) == 0 );
+
+    // A hash is only found in its own salt group.
+    TestCase( findDigest( &set, 0, h3 ) >= 0 && findDigest( &set, 1, h3 ) < 0 &&
+              findDigest( &set, 1, h2 ) >= 0 );
+
+    freeTargetSet( &set );
+  }
+
+  ///////////////////////////////////////////////////////////////
+  // Test the writer component
+
+  {
+    TargetSet set;
+    initTargetSet( &set );
+
+    byte h1[ HASH_SIZE ], h2[ HASH_SIZE ];
+    stringToHash( "aKsVVoNzLcSBRrhy4mexs.", h1 );
+    stringToHash( "MPPZJeod4Sk89awLhwv591", h2 );
+    addTarget( &set, "bob", "dBufmvX4", h1 );
+    addTarget( &set, "eval", "abcdefgh", h2 );
+    addTarget( &set, "pat", "dBufmvX4", h2 );
+
+    FILE *out = tmpfile();
+    ResultWriter *writer = startWriter( &set, 2, out, NULL );
+
+    // Matches come in out of order, from two producers.
+    submitMatch( writer, 1, 2, 7, "seven" );
+    submitMatch( writer, 0, 1, 3, "three" );
+    submitMatch( writer, 1, 0, 9, "nine" );
+    submitMatch( writer, 0, 0, 4, "four" );
+    finishGroup( writer, 1 );
+    finishGroup( writer, 0 );
+    finishGroup( writer, 0 );
+
+    // They should come out in user order, then word order.
+    TestCase( finishWriter( writer ) == 4 );
+
+    char text[ 100 ] = "";
+    rewind( out );
+    int len = fread( text, 1, sizeof( text ) - 1, out );
+    text[ len ] = '\0';
+    TestCase( strcmp( text, "bob : four\nbob : nine\neval : three\npat : seven\n" ) == 0 );
+
+    fclose( out );
+    freeTargetSet( &set );
+  }
+
+  ///////////////////////////////////////////////////////////////
+  // Test the dictionary component
+
+  {
+    // The last word has no newline, and an empty line is an empty word. Words come
+    // out grouped by length, in file order within each length.
+    char const *name = "unitTest-dictionary.txt";
+    FILE *fp = fopen( name, "w" );
+    fputs( "apple\n\nbanana\ncherry", fp );
+    fclose( fp );
+
+    Dictionary dict;
+    TestCase( openDictionary( &dict, name ) && indexDictionary( &dict, 3 ) &&
+              dict.count == 4 );
+
+    int len0, len1, len3;
+    dictionaryWord( &dict, 0, &len0 );
+    char const *w1 = dictionaryWord( &dict, 1, &len1 );
+    char const *w3 = dictionaryWord( &dict, 3, &len3 );
+    TestCase( len0 == 0 && len1 == 5 && strcmp( w1, "apple" ) == 0 &&
+              len3 == 6 && strcmp( w3, "cherry" ) == 0 );
+
+    // A run of words can start partway through a length.
+    char const *words[ 4 ];
+    int lens[ 4 ];
+    TestCase( dictionaryWords( &dict, 2, 4, words, lens ) == 2 &&
+              strcmp( words[ 0 ], "banana" ) == 0 && lens[ 1 ] == 6 );
+    closeDictionary( &dict );
+
+    // A word that's too long is rejected.
+    fp = fopen( name, "w" );
+    fputs( "short\nthiswordiswaytoolong\n", fp );
+    fclose( fp );
+    TestCase( openDictionary( &dict, name ) && !indexDictionary( &dict, 1 ) );
+    closeDictionary( &dict );
+    remove( name );
+  }
+
+  ///////////////////////////////////////////////////////////////
+  // Test the shadow component
+
+  {
+    // Extra fields are ignored, and so are blank lines.
+    char const *name = "unitTest-shadow.txt";
+    FILE *fp = fopen( name, "w" );
+    fputs( "bob:$1$dBufmvX4$aKsVVoNzLcSBRrhy4mexs.:20009:0:99999:7:::\n\n"
+           "eval:$1$abcdefgh$MPPZJeod4Sk89awLhwv591\n"
+           "cory:$1$Fhoqn0YrO$OcvSCk27oHZglYwvt8c7t.:20020:0:99999:7:::\n", fp );
+    fclose( fp );
+
+    ShadowFile shadow;
+    ShadowEntry entry;
+    TestCase( openShadow( &shadow, name ) &&
+              readShadowEntry( &shadow, &entry ) == SHADOW_ENTRY &&
+              strcmp( entry.name, "bob" ) == 0 && strcmp( entry.salt, "dBufmvX4" ) == 0 &&
+              strcmp( entry.hash, "aKsVVoNzLcSBRrhy4mexs." ) == 0 );
+
+    // The last field can end the line.
+    TestCase( readShadowEntry( &shadow, &entry ) == SHADOW_ENTRY &&
+              strcmp( entry.name, "eval" ) == 0 &&
+              strcmp( entry.hash, "MPPZJeod4Sk89awLhwv591" ) == 0 );
+
+    // A salt that's too long makes the entry invalid.
+    TestCase( readShadowEntry( &shadow, &entry ) == SHADOW_INVALID );
+    closeShadow( &shadow );
+    remove( name );
+  }
+
+  ///////////////////////////////////////////////////////////////
+  // Test the stream component
+
+  {
+    // Words come through a pipe, and the last one has no newline.
+    FILE *fp = tmpfile();
+    fputs( "apple\n\nbanana", fp );
+    rewind( fp );
+
+    WordStream stream;
+    openWordStream( &stream, fileno( fp ) );
+    char a[ PW_LIMIT + 1 ], b[ PW_LIMIT + 1 ], c[ PW_LIMIT + 1 ];
+    TestCase( readStreamWord( &stream, a ) == STREAM_WORD &&
+              readStreamWord( &stream, b ) == STREAM_WORD &&
+              readStreamWord( &stream, c ) == STREAM_WORD &&
+              readStreamWord( &stream, c ) == STREAM_END &&
+              strcmp( a, "apple" ) == 0 && b[ 0 ] == '\0' && strcmp( c, "banana" ) == 0 );
+    closeWordStream( &stream );
+    fclose( fp );
+
+    // A word that's too long is rejected.
+    fp = tmpfile();
+    fputs( "thiswordiswaytoolong\n", fp );
+    rewind( fp );
+    openWordStream( &stream, fileno( fp ) );
+    TestCase( readStreamWord( &stream, a ) == STREAM_INVALID );
+    closeWordStream( &stream );
+    fclose( fp );
+  }
+
+  ///////////////////////////////////////////////////////////////
+  // Test the rules component
+
+  {
+    RuleSet rules;
+    initRuleSet( &rules );
+    TestCase( addRule( &rules, "c $1 $!" ) && addRule( &rules, "sa@ so0 r" ) &&
+              addRule( &rules, "d" ) && !addRule( &rules, "s" ) && !addRule( &rules, "x" ) );
+
+    char out[ PW_LIMIT + 1 ];
+    TestCase( applyRule( &rules.rules[ 0 ], "password", 8, out ) == 10 &&
+              strcmp( out, "Password1!" ) == 0 );
+    TestCase( applyRule( &rules.rules[ 1 ], "football", 8, out ) == 8 &&
+              strcmp( out, "ll@bt00f" ) == 0 );
+
+    // A word that grows too long is cut to PW_LIMIT.
+    TestCase( applyRule( &rules.rules[ 2 ], "landlady", 8, out ) == PW_LIMIT &&
+              strcmp( out, "landladylandlad" ) == 0 );
+    freeRuleSet( &rules );
+  }
+
+  ///////////////////////////////////////////////////////////////
+  // Test the mask component
+
+  {
+    // Run incrementally, ?d?l?? covers 10 one-character candidates, 260 of two
+    // characters and 260 of three.
+    Mask mask;
+    TestCase( parseMask( &mask, "?d?l??", true ) && maskKeyspace( &mask ) == 530 );
+
+    char word[ PW_LIMIT + 1 ];
+    TestCase( maskCandidate( &mask, 9, word ) == 1 && strcmp( word, "9" ) == 0 &&
+              maskCandidate( &mask, 10, word ) == 2 && strcmp( word, "0a" ) == 0 &&
+              maskCandidate( &mask, 529, word ) == 3 && strcmp( word, "9z?" ) == 0 );
+
+    // Stepping through a length gives the same candidates as decoding each index.
+    bool same = true;
+    char step[ PW_LIMIT + 1 ];
+    maskCandidate( &mask, 10, step );
+    for ( int i = 11; i < 270; i++ ) {
+      same = same && nextMaskCandidate( &mask, step, 2 );
+      maskCandidate( &mask, i, word );
+      same = same && strcmp( step, word ) == 0;
+    }
+    TestCase( same && !nextMaskCandidate( &mask, step, 2 ) &&
+              !parseMask( &mask, "?a?a?a?a?a?a?a?a?a?a?a", false ) );
+  }
+
+  ///////////////////////////////////////////////////////////////
+  // Test the dedup component
+
+  {
+    // The exact filter turns away only what it has seen, whatever the length.
+    Dedup dedup;
+    initDedup( &dedup, DEDUP_EXACT, 0 );
+    bool exact = true;
+    char word[ PW_LIMIT + 1 ];
+    for ( int i = 0; i < 5000; i++ ) {
+      int len = sprintf( word, "w%d", i );
+      exact = exact && firstSighting( &dedup, word, len );
+    }
+    for ( int i = 0; i < 5000; i += 7 ) {
+      int len = sprintf( word, "w%d", i );
+      exact = exact && !firstSighting( &dedup, word, len );
+    }
+    TestCase( exact && firstSighting( &dedup, "w1", 1 ) && !firstSighting( &dedup, "w", 1 ) &&
+              dedup.passed == 5001 && dedup.skipped == 715 + 1 );
+    freeDedup( &dedup );
+
+    // A small Bloom filter remembers everything it's seen, and lets nearly
+    // everything new through.
+    initDedup( &dedup, DEDUP_BLOOM, 65536 );
+    int fresh = 0;
+    for ( int i = 0; i < 2000; i++ ) {
+      int len = sprintf( word, "w%d", i );
+      fresh += firstSighting( &dedup, word, len );
+    }
+    bool remembered = true;
+    for ( int i = 0; i < 2000; i++ ) {
+      int len = sprintf( word, "w%d", i );
+      remembered = remembered && !firstSighting( &dedup, word, len );
+    }
+    TestCase( dedup.blocks == 1024 && fresh > 1990 && remembered );
+    freeDedup( &dedup );
+  }
+
+  ///////////////////////////////////////////////////////////////
+  // Test the potfile component
+
+  {
+    // One good entry, one with a bad hash, and a last line cut short.
+    char const *name = "unitTest-potfile.txt";
+    FILE *fp = fopen( name, "w" );
+    fputs( "$1$abcdefgh$MPPZJeod4Sk89awLhwv591:a:b\n"
+           "$1$abcdefgh$MPPZJeod4Sk89awLhwv5*1:bad\n"
+           "$1$12345678$JKUg", fp );
+    fclose( fp );
+
+    byte h1[ HASH_SIZE ], h2[ HASH_SIZE ];
+    stringToHash( "MPPZJeod4Sk89awLhwv591", h1 );
+    stringToHash( "JKUg1ByWFvKwjFHwMFLcD1", h2 );
+    Potfile pot;
+    TestCase( openPotfile( &pot, name ) && pot.count == 1 &&
+              strcmp( findPot( &pot, "abcdefgh", h1 ), "a:b" ) == 0 &&
+              findPot( &pot, "12345678", h1 ) == NULL );
+
+    // A new entry is there the next time the file is opened.
+    addPot( &pot, "12345678", h2, "secret" );
+    addPot( &pot, "12345678", h2, "secret" );
+    closePotfile( &pot );
+    TestCase( openPotfile( &pot, name ) && pot.count == 2 &&
+              strcmp( findPot( &pot, "12345678", h2 ), "secret" ) == 0 );
+    closePotfile( &pot );
+    remove( name );
+  }
+
+  ///////////////////////////////////////////////////////////////
+  // Test the checkpoint component
+
+  {
+    char const *name = "unitTest-checkpoint.txt";
+    FILE *fp = fopen( name, "w" );
+    fputs( "crack checkpoint 1\njob words.txt shadow.txt\ncursor 4096\n"
+           "$1$abcdefgh$MPPZJeod4Sk89awLhwv591:password\n", fp );
+    fclose( fp );
+
+    byte hash[ HASH_SIZE ];
+    stringToHash( "MPPZJeod4Sk89awLhwv591", hash );
+    Potfile cracked;
+    initPotfile( &cracked );
+    long long cursor = 0;
+    TestCase( loadCheckpoint( name, "words.txt shadow.txt", &cursor, &cracked ) ==
+              CHECKPOINT_LOADED && cursor == 4096 &&
+              strcmp( findPot( &cracked, "abcdefgh", hash ), "password" ) == 0 );
+
+    // A checkpoint only restores into the job it came from.
+    TestCase( loadCheckpoint( name, "other.txt shadow.txt", &cursor, &cracked ) ==
+              CHECKPOINT_MISMATCH );
+    closePotfile( &cracked );
+
+    // A line cut short makes the checkpoint invalid.
+    fp = fopen( name, "w" );
+    fputs( "crack checkpoint 1\njob words.txt shadow.txt\ncursor 4096\n$1$abc", fp );
+    fclose( fp );
+    initPotfile( &cracked );
+    TestCase( loadCheckpoint( name, "words.txt shadow.txt", &cursor, &cracked ) ==
+              CHECKPOINT_INVALID );
+    closePotfile( &cracked );
+    remove( name );
+  }
+
+  ///////////////////////////////////////////////////////////////
+  // Test the merge component
+
+  {
+    byte hash[ HASH_SIZE ] = { 0 };
+    TargetSet set;
+    initTargetSet( &set );
+    addTarget( &set, "bob", "abcdefgh", hash );
+    addTarget( &set, "amy", "abcdefgh", hash );
+    addTarget( &set, "bob", "dBufmvX4", hash );
+
+    // Two users with the same name are told apart by their order.
+    char const *first = "unitTest-shard1.txt";
+    char const *second = "unitTest-shard2.txt";
+    FILE *fp = fopen( first, "w" );
+    fputs( "bob : one\nbob : two : three\n", fp );
+    fclose( fp );
+    fp = fopen( second, "w" );
+    fputs( "amy : x\nbob : two : three\n", fp );
+    fclose( fp );
+
+    ResultMerge merge;
+    initMerge( &merge, &set );
+    int line;
+    TestCase( mergeResults( &merge, second, &line ) == MERGE_OK &&
+              mergeResults( &merge, first, &line ) == MERGE_OK &&
+              strcmp( merge.passwords[ 0 ], "one" ) == 0 &&
+              strcmp( merge.passwords[ 1 ], "x" ) == 0 &&
+              strcmp( merge.passwords[ 2 ], "two : three" ) == 0 );
+
+    // A user that isn't in the shadow file, or isn't after the last one, is invalid.
+    fp = fopen( first, "w" );
+    fputs( "amy : x\namy : y\n", fp );
+    fclose( fp );
+    TestCase( mergeResults( &merge, first, &line ) == MERGE_INVALID && line == 2 );
+    freeMerge( &merge );
+    freeTargetSet( &set );
+    remove( first );
+    remove( second );
+  }
+
+  ///////////////////////////////////////////////////////////////
+  // Test the lease component
+
+  {
+    // Fresh leases are cut from the front, and the last one stops at the end.
+    LeaseTable table;
+    initLeases( &table, 250, 10 );
+    Lease a, b, c;
+    TestCase( grantLease( &table, 1, 200, 0, &a ) && a.start == 0 && a.end == 200 &&
+              grantLease( &table, 2, 200, 0, &b ) && b.start == 200 && b.end == 250 &&
+              !grantLease( &table, 3, 200, 5, &c ) && !leasesDone( &table ) );
+
+    // An expired lease goes to the next worker that asks, and counts once it's
+    // finished by anyone.
+    TestCase( finishLease( &table, b.id ) && grantLease( &table, 3, 200, 10, &c ) &&
+              c.id == a.id && c.owner == 3 && finishLease( &table, a.id ) &&
+              !finishLease( &table, c.id ) && leasesDone( &table ) );
+    freeLeases( &table );
+  }
+
 #ifdef DISABLE_TESTS
   // Once you move the #ifdef DISABLE_TESTS to here, you've enabled
   // all the tests.
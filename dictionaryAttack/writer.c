@@ -0,0 +1,385 @@
+/**
+ * @file writer.c
+ * @author Sean Leana (smleana)
+ * This file writes out matches in reporting order while the workers are still hashing.
+ * Every worker appends its matches to its own lock-free queue of chunks, so workers
+ * never wait on each other or on the writer. The writer thread drains the queues,
+ * holds each match until its user comes up in shadow file order, and writes a user's
+ * lines as soon as no more matches can come for it, collecting the output in a large
+ * buffer so it goes out in a few big writes rather than one per line. Only the writer
+ * thread touches the potfile, so passwords are appended to it as they're drained,
+ * without any locking.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "writer.h"
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+
+/** Number of matches in one chunk of a producer's queue. */
+#define CHUNK_MATCHES 256
+
+/** Size of the output buffer; it's written out whenever it fills up. */
+#define OUTPUT_SIZE 65536
+
+/** How long the writer sleeps, in nanoseconds, when there's nothing for it to do. */
+#define IDLE_NANOS 200000
+
+/** A block of matches in a producer's queue. */
+typedef struct MatchChunkStruct {
+    /** The matches. */
+    Match items[CHUNK_MATCHES];
+
+    /** The next chunk, once the producer has filled this one. */
+    struct MatchChunkStruct *next;
+} MatchChunk;
+
+/** Matches from one producer, waiting for the writer. Only the producer touches the
+    tail, and only the writer touches the head. */
+typedef struct {
+    /** Chunk the writer is reading from, and the next match it will read there. */
+    MatchChunk *head;
+    int headPos;
+
+    /** Number of matches the writer has taken from the queue. */
+    long long consumed;
+
+    /** Keeps the producer's fields off the writer's cache line. */
+    char pad[64];
+
+    /** Chunk the producer is adding to, and the next free spot there. */
+    MatchChunk *tail;
+    int tailPos;
+
+    /** Number of matches the producer has added to the queue. */
+    long long produced;
+} MatchQueue;
+
+/** State shared by the producers and the writer thread. */
+struct ResultWriterStruct {
+    /** The users being cracked. */
+    TargetSet const *targets;
+
+    /** One queue per producer. */
+    MatchQueue *queues;
+    int producers;
+
+    /** For each salt group, set once no more matches can come for it. */
+    int *groupDone;
+
+    /** For each user, set once it's cracked and no more matches will come for it. */
+    int *userDone;
+
+    /** Matches taken from the queues that haven't been written yet. */
+    Match *pending;
+    int *pendingNext;
+    int pendingCount;
+    int pendingCapacity;
+
+    /** Number of pending matches that haven't been written yet. */
+    int held;
+
+    /** For each user, its first pending match, or -1. */
+    int *userPending;
+
+    /** Next user to write out, in shadow file order. */
+    int nextUser;
+
+    /** Number of lines written so far. */
+    long long written;
+
+    /** Where the lines go, and the buffer they're collected in first. */
+    FILE *out;
+    char *buffer;
+    int bufferLen;
+
+    /** Potfile new passwords are appended to, or NULL. */
+    Potfile *pot;
+
+    /** The thread running the writer. */
+    pthread_t thread;
+};
+
+/**
+ * Writes out the output buffer.
+ * @param w the writer
+ */
+static void flushOutput(ResultWriter *w)
+{
+    if (w->out == NULL) {
+        return;
+    }
+    if (w->bufferLen > 0) {
+        fwrite(w->buffer, 1, w->bufferLen, w->out);
+        w->bufferLen = 0;
+    }
+    fflush(w->out);
+}
+
+/**
+ * Adds one line to the output buffer, writing the buffer out first if it's full.
+ * @param w the writer
+ * @param name the user's name
+ * @param password the password that cracked it
+ */
+static void writeLine(ResultWriter *w, char const *name, char const *password)
+{
+    if (w->out == NULL) {
+        w->written++;
+        return;
+    }
+    if (w->bufferLen + USERNAME_LIMIT + PW_LIMIT + 4 > OUTPUT_SIZE) {
+        fwrite(w->buffer, 1, w->bufferLen, w->out);
+        w->bufferLen = 0;
+    }
+    int len = strlen(name);
+    memcpy(w->buffer + w->bufferLen, name, len);
+    w->bufferLen += len;
+    memcpy(w->buffer + w->bufferLen, " : ", 3);
+    w->bufferLen += 3;
+    len = strlen(password);
+    memcpy(w->buffer + w->bufferLen, password, len);
+    w->bufferLen += len;
+    w->buffer[w->bufferLen++] = '\n';
+    w->written++;
+}
+
+/**
+ * Appends a newly cracked password to the potfile, once for each salt and hash, if
+ * there's a potfile and the password wasn't known already.
+ * @param w the writer
+ * @param m the match
+ * @return true if the password went into the potfile
+ */
+static bool potMatch(ResultWriter *w, Match const *m)
+{
+    TargetSet const *targets = w->targets;
+    Digest const *digest = &targets->digests[targets->users[m->user].digest];
+    if (w->pot == NULL || m->word < 0 || digest->firstUser != m->user) {
+        return false;
+    }
+    addPot(w->pot, targets->groups[digest->group].salt, digest->hash, m->password);
+    return true;
+}
+
+/**
+ * Takes every match the producers have finished adding from their queues, and files
+ * each one under its user.
+ * @param w the writer
+ */
+static void drainQueues(ResultWriter *w)
+{
+    bool potted = false;
+    for (int p = 0; p < w->producers; p++) {
+        MatchQueue *q = &w->queues[p];
+        long long available = __atomic_load_n(&q->produced, __ATOMIC_ACQUIRE);
+        while (q->consumed < available) {
+            if (q->headPos == CHUNK_MATCHES) {
+                MatchChunk *next = __atomic_load_n(&q->head->next, __ATOMIC_ACQUIRE);
+                free(q->head);
+                q->head = next;
+                q->headPos = 0;
+            }
+            if (w->pendingCount >= w->pendingCapacity) {
+                w->pendingCapacity *= 2;
+                w->pending = (Match *) realloc(w->pending, w->pendingCapacity * sizeof(Match));
+                w->pendingNext = (int *) realloc(w->pendingNext,
+                                                 w->pendingCapacity * sizeof(int));
+            }
+            int m = w->pendingCount++;
+            w->pending[m] = q->head->items[q->headPos++];
+            w->pendingNext[m] = w->userPending[w->pending[m].user];
+            w->userPending[w->pending[m].user] = m;
+            w->held++;
+            q->consumed++;
+            potted = potMatch(w, &w->pending[m]) || potted;
+        }
+    }
+    if (potted) {
+        flushPot(w->pot);
+    }
+}
+
+/**
+ * Finds how far the writer can go: the first user, from the next one to write, that
+ * isn't cracked and whose salt group isn't finished yet.
+ * @param w the writer
+ * @return index of that user, or the number of users if they're all done
+ */
+static int readyLimit(ResultWriter *w)
+{
+    TargetSet const *targets = w->targets;
+    int u = w->nextUser;
+    while (u < targets->userCount
+            && (__atomic_load_n(&w->userDone[u], __ATOMIC_ACQUIRE)
+                || __atomic_load_n(&w->groupDone[targets->digests[targets->users[u].digest].group],
+                                   __ATOMIC_ACQUIRE))) {
+        u++;
+    }
+    return u;
+}
+
+/**
+ * Writes out the next users in shadow file order, up to the given one. A user's
+ * matches are written in dictionary order.
+ * @param w the writer
+ * @param limit index of the first user not to write
+ */
+static void writeUsers(ResultWriter *w, int limit)
+{
+    for (; w->nextUser < limit; w->nextUser++) {
+        int u = w->nextUser;
+
+        // A user seldom has more than one match, so a selection sort is plenty.
+        while (w->userPending[u] >= 0) {
+            int *first = &w->userPending[u];
+            for (int *m = &w->pendingNext[*first]; *m >= 0; m = &w->pendingNext[*m]) {
+                if (w->pending[*m].word < w->pending[*first].word) {
+                    first = m;
+                }
+            }
+            writeLine(w, w->targets->users[u].name, w->pending[*first].password);
+            *first = w->pendingNext[*first];
+            w->held--;
+        }
+    }
+
+    // Once nothing is held back, the pending list can start over.
+    if (w->held == 0) {
+        w->pendingCount = 0;
+    }
+}
+
+/**
+ * Runs the writer until every user has been written out.
+ * @param arg the writer
+ * @return NULL
+ */
+static void *writerMain(void *arg)
+{
+    ResultWriter *w = (ResultWriter *) arg;
+    struct timespec idle = { 0, IDLE_NANOS };
+    while (w->nextUser < w->targets->userCount) {
+        // Look at the groups before draining, so every match for a finished group is
+        // in hand before its users are written.
+        int limit = readyLimit(w);
+        drainQueues(w);
+        if (limit > w->nextUser) {
+            writeUsers(w, limit);
+            flushOutput(w);
+        } else {
+            nanosleep(&idle, NULL);
+        }
+    }
+    drainQueues(w);
+    flushOutput(w);
+    return NULL;
+}
+
+/**
+ * Starts a writer thread for the given targets.
+ * @param targets the users being cracked
+ * @param producers number of threads that will submit matches
+ * @param out where the matched lines are written
+ * @param pot potfile for newly cracked passwords, or NULL
+ * @return the new writer
+ */
+ResultWriter *startWriter(TargetSet const *targets, int producers, FILE *out, Potfile *pot)
+{
+    ResultWriter *w = (ResultWriter *) calloc(1, sizeof(ResultWriter));
+    w->targets = targets;
+    w->producers = producers;
+    w->queues = (MatchQueue *) calloc(producers, sizeof(MatchQueue));
+    for (int p = 0; p < producers; p++) {
+        MatchChunk *chunk = (MatchChunk *) calloc(1, sizeof(MatchChunk));
+        w->queues[p].head = chunk;
+        w->queues[p].tail = chunk;
+    }
+    w->groupDone = (int *) calloc(targets->groupCount + 1, sizeof(int));
+    w->userDone = (int *) calloc(targets->userCount + 1, sizeof(int));
+    w->pendingCapacity = 16;
+    w->pending = (Match *) malloc(w->pendingCapacity * sizeof(Match));
+    w->pendingNext = (int *) malloc(w->pendingCapacity * sizeof(int));
+    w->userPending = (int *) malloc((targets->userCount + 1) * sizeof(int));
+    for (int u = 0; u < targets->userCount; u++) {
+        w->userPending[u] = -1;
+    }
+    w->out = out;
+    w->pot = pot;
+    w->buffer = (char *) malloc(OUTPUT_SIZE);
+
+    pthread_create(&w->thread, NULL, writerMain, w);
+    return w;
+}
+
+/**
+ * Adds a match to a producer's queue. Only that producer may call this with its index.
+ * @param w the writer
+ * @param producer index of the calling producer
+ * @param user index of the cracked user
+ * @param word position of the word that cracked it in the stream of candidates
+ * @param password the word that cracked it
+ */
+void submitMatch(ResultWriter *w, int producer, int user, long long word,
+                 char const *password)
+{
+    MatchQueue *q = &w->queues[producer];
+    if (q->tailPos == CHUNK_MATCHES) {
+        MatchChunk *chunk = (MatchChunk *) calloc(1, sizeof(MatchChunk));
+        __atomic_store_n(&q->tail->next, chunk, __ATOMIC_RELEASE);
+        q->tail = chunk;
+        q->tailPos = 0;
+    }
+    Match *m = &q->tail->items[q->tailPos++];
+    m->user = user;
+    m->word = word;
+    strcpy(m->password, password);
+    __atomic_store_n(&q->produced, q->produced + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Marks a salt group as finished, so its users can be written out.
+ * @param w the writer
+ * @param group index of the salt group
+ */
+void finishGroup(ResultWriter *w, int group)
+{
+    __atomic_store_n(&w->groupDone[group], 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Marks a user as cracked, so it can be written out without waiting for its group.
+ * @param w the writer
+ * @param user index of the user
+ */
+void finishUser(ResultWriter *w, int user)
+{
+    __atomic_store_n(&w->userDone[user], 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Waits for the writer thread to write out every user, then frees the writer.
+ * @param w the writer
+ * @return the number of lines written
+ */
+long long finishWriter(ResultWriter *w)
+{
+    pthread_join(w->thread, NULL);
+    long long written = w->written;
+    for (int p = 0; p < w->producers; p++) {
+        free(w->queues[p].head);
+    }
+    free(w->queues);
+    free(w->groupDone);
+    free(w->userDone);
+    free(w->pending);
+    free(w->pendingNext);
+    free(w->userPending);
+    free(w->buffer);
+    free(w);
+    return written;
+}
+
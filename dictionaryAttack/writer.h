@@ -0,0 +1,57 @@
+/**
+ * @file writer.h
+ * @author Sean Leana (smleana)
+ * This file defines the result writer, which takes matches from the worker threads in
+ * any order and writes them out in shadow file order, then dictionary order, as soon
+ * as everything before them is known. Newly cracked passwords can also be recorded
+ * in a potfile as soon as they arrive.
+ */
+
+#ifndef _WRITER_H_
+#define _WRITER_H_
+
+#include "target.h"
+#include "potfile.h"
+#include <stdio.h>
+
+/** A user cracked by a candidate word. */
+typedef struct {
+    /** Index of the user in the target set. */
+    int user;
+
+    /** Position of the word in the stream of candidates, or -1 if the password was
+        already known. */
+    long long word;
+
+    /** The word itself. */
+    char password[PW_LIMIT + 1];
+} Match;
+
+/** A running result writer; the details are private to the writer component. */
+typedef struct ResultWriterStruct ResultWriter;
+
+/** starts a writer thread that writes matches for the given targets to out, unless
+ * it's NULL, and appends newly cracked passwords to pot unless it's NULL. Each of
+ * the producers submits matches through its own lock-free queue. */
+ResultWriter *startWriter( TargetSet const *targets, int producers, FILE *out,
+                           Potfile *pot );
+
+/** hands a match to the writer; only the given producer may use its queue */
+void submitMatch( ResultWriter *writer, int producer, int user, long long word,
+                  char const *password );
+
+/** tells the writer no more matches will come for the given salt group, so its users
+ * can be written out once the users before them are; this may be called more than
+ * once for the same group */
+void finishGroup( ResultWriter *writer, int group );
+
+/** tells the writer no more matches will come for the given user, because it has
+ * been cracked; the user's match must already have been submitted */
+void finishUser( ResultWriter *writer, int user );
+
+/** waits until every user has been written out, flushes the output and frees the
+ * writer, returning the number of lines written; every group must have been
+ * finished first */
+long long finishWriter( ResultWriter *writer );
+
+#endif